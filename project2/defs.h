@@ -5,8 +5,12 @@ struct inode;
 struct pipe;
 struct proc;
 struct rtcdate;
+struct cpustat;
+struct mlfqconf;
+struct pstat;
 struct spinlock;
 struct sleeplock;
+struct timer;
 struct stat;
 struct superblock;
 
@@ -77,6 +81,8 @@ void            cmostime(struct rtcdate *r);
 int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
+void            lapicipi(uchar, int);
+void            lapicspin(uint);
 void            lapicinit(void);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
@@ -119,9 +125,16 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
+void            wakeupone(void*);
 void            yield(void);
+int             needresched(void);
 int 		setpriority(int pid, int pty);
 int		getlev(void); 
+int             getcpustat(struct cpustat*, int);
+int             getmlfq(struct mlfqconf*);
+int             setmlfq(struct mlfqconf*);
+int             settickets(int);
+int             getpinfo(struct pstat*, int);
 
 // swtch.S
 void            swtch(struct context**, struct context*);
@@ -159,11 +172,16 @@ int             fetchstr(uint, char**);
 void            syscall(void);
 
 // timer.c
-void            timerinit(void);
+void            timeradd(struct timer*, uint);
+void            timerdel(struct timer*);
+void            timertick(void);
+int             sleepuntil(uint);
 
 // trap.c
 void            idtinit(void);
 extern uint     ticks;
+extern volatile uint boostepoch;
+extern volatile uint boostperiod;
 void            tvinit(void);
 extern struct spinlock tickslock;
 
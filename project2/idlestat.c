@@ -0,0 +1,32 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "pstat.h"
+
+// Print how much of the last few seconds each CPU spent halted.
+// usage: idlestat [ticks]
+
+int main(int argc, char *argv[])
+{
+  struct cpustat before[NCPU], after[NCPU];
+  int i, n, period, ticks, idle;
+
+  period = 100;
+  if (argc > 1)
+    period = atoi(argv[1]);
+
+  n = getcpustat(before, NCPU);
+  sleep(period);
+  getcpustat(after, NCPU);
+
+  for (i = 0; i < n; i++)
+  {
+    ticks = after[i].ticks - before[i].ticks;
+    idle = after[i].idleticks - before[i].idleticks;
+    printf(1, "cpu%d: %d%% idle (%d/%d ticks), %d halts\n", i,
+           ticks ? idle * 100 / ticks : 0, idle, ticks,
+           after[i].halts - before[i].halts);
+  }
+  exit();
+}
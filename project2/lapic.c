@@ -9,6 +9,7 @@
 #include "traps.h"
 #include "mmu.h"
 #include "x86.h"
+#include "proc.h"
 
 // Local APIC registers, divided by 4 for use as uint[] indices.
 #define ID      (0x0020/4)   // ID
@@ -66,7 +67,8 @@ lapicinit(void)
   // TICR would be calibrated using an external time source.
   lapicw(TDCR, X1);
   lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
-  lapicw(TICR, 10000000);
+  // One count per nanosecond of the nominal tick; see lapicspin().
+  lapicw(TICR, TICKNS);
 
   // Disable logical interrupt lines.
   lapicw(LINT0, MASKED);
@@ -113,6 +115,70 @@ lapiceoi(void)
     lapicw(EOI, 0);
 }
 
+// Send an interrupt with the given vector to one other CPU.
+void
+lapicipi(uchar apicid, int vector)
+{
+  if(!lapic)
+    return;
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+}
+
+// Spin for n timer counts, nanoseconds at the nominal tick
+// rate, n below one tick. Interrupts stay on, and the cpu is
+// given up whenever other work is queued for it. The count runs
+// down from TICR and reloads with each timer interrupt, so the
+// cpu's tick count tells a reload seen from one gone unseen.
+// Time after a move to another cpu is counted from the move, so
+// the wait may run long but never short.
+void
+lapicspin(uint n)
+{
+  struct cpu *c;
+  uint prev, now, seen, done;
+  int unseen;
+
+  if(!lapic || n == 0)
+    return;
+  if(n >= TICKNS)
+    n = TICKNS - 1;
+  pushcli();
+  c = mycpu();
+  prev = lapic[TCCR];
+  seen = c->ticks;
+  popcli();
+  done = 0;
+  while(done < n){
+    if(needresched())
+      yield();
+    pushcli();
+    if(mycpu() != c){
+      c = mycpu();
+      prev = lapic[TCCR];
+      seen = c->ticks;
+      popcli();
+      continue;
+    }
+    now = lapic[TCCR];
+    unseen = c->ticks - seen;
+    popcli();
+    if(now > prev){
+      // One reload; its interrupt may still be pending.
+      done += prev + TICKNS - now;
+      seen++;
+      unseen--;
+    } else
+      done += prev - now;
+    // Another reload went by while we were away: a whole tick.
+    if(unseen > 0)
+      break;
+    prev = now;
+  }
+}
+
 // Spin for a given number of microseconds.
 // On real hardware would want to tune this dynamically.
 void
@@ -42,6 +42,7 @@ struct log {
   int size;
   int outstanding; // how many FS sys calls are executing.
   int committing;  // in commit(), please wait.
+  int waiting;     // how many begin_op() calls are asleep.
   int dev;
   struct logheader lh;
 };
@@ -127,13 +128,17 @@ begin_op(void)
 {
   acquire(&log.lock);
   while(1){
-    if(log.committing){
-      sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
-      // this op might exhaust log space; wait for commit.
+    if(log.committing ||
+       log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
+      // committing, or this op might exhaust log space; wait.
+      log.waiting += 1;
       sleep(&log, &log.lock);
+      log.waiting -= 1;
     } else {
       log.outstanding += 1;
+      // waiters are woken one at a time; the next may fit too.
+      if(log.waiting)
+        wakeupone(&log);
       release(&log.lock);
       break;
     }
@@ -158,7 +163,8 @@ end_op(void)
     // begin_op() may be waiting for log space,
     // and decrementing log.outstanding has decreased
     // the amount of reserved space.
-    wakeup(&log);
+    if(log.waiting)
+      wakeupone(&log);
   }
   release(&log.lock);
 
@@ -168,7 +174,8 @@ end_op(void)
     commit();
     acquire(&log.lock);
     log.committing = 0;
-    wakeup(&log);
+    if(log.waiting)
+      wakeupone(&log);
     release(&log.lock);
   }
 }
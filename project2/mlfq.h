@@ -0,0 +1,6 @@
+// MLFQ tuning, read and set at run time by getmlfq()/setmlfq().
+struct mlfqconf {
+  int nlevel;            // Number of levels in use, 1..NLEVEL
+  int quantum[NLEVEL];   // Time quantum of each level, in ticks
+  int boost;             // Ticks between priority boosts, 0 for none
+};
@@ -8,6 +8,12 @@
 
 #define NUM_THREAD 4
 #define MAX_LEVEL 5
+#define NUM_PICK 2000
+#define NUM_HOG 4
+#define STARVE_TICKS 500
+#define BOOST_TICKS 100
+
+int bench_procs[] = {8, 64, 512};
 
 int parent;
 
@@ -70,6 +76,91 @@ void exit_children()
   while (wait() != -1);
 }
 
+// Every child yields NUM_PICK times, so each yield is one trip
+// through the scheduler's pick. Reports the average cost per pick.
+void pick_latency(int n)
+{
+  int i, j, p, got, start, elapsed;
+
+  start = uptime();
+  for (got = 0; got < n; got++)
+  {
+    if ((p = fork()) < 0)
+      break;
+    if (p == 0)
+    {
+      for (j = 0; j < NUM_PICK; j++)
+        yield();
+      exit();
+    }
+  }
+  for (i = 0; i < got; i++)
+    wait();
+  elapsed = uptime() - start;
+  if (got == 0)
+  {
+    printf(1, "fork failed\n");
+    return;
+  }
+
+  printf(1, "%d processes", got);
+  if (got < n)
+    printf(1, " (%d requested, proc table full)", n);
+  printf(1, ": %d picks in %d ticks, %d us/pick\n",
+         got * NUM_PICK, elapsed, elapsed * 10000 / (got * NUM_PICK));
+}
+
+// NUM_HOG processes keep level 0 busy by yielding (which keeps
+// them at level 0) while one CPU-bound process sinks to the last
+// level. Only priority boosting lets it run; report the longest it
+// went without the CPU.
+void starvation(void)
+{
+  int i, p, start, now, last, gap, worst, lv, maxlv;
+  int fds[2];
+
+  pipe(fds);
+  start = uptime();
+  for (i = 0; i < NUM_HOG; i++)
+  {
+    if ((p = fork()) == 0)
+    {
+      while (uptime() < start + STARVE_TICKS + 20)
+        yield();
+      exit();
+    }
+  }
+  if ((p = fork()) == 0)
+  {
+    worst = maxlv = 0;
+    last = uptime();
+    while ((now = uptime()) < start + STARVE_TICKS)
+    {
+      gap = now - last;
+      if (gap > worst)
+        worst = gap;
+      last = now;
+      lv = getlev();
+      if (lv > maxlv)
+        maxlv = lv;
+    }
+    write(fds[1], &worst, sizeof(worst));
+    write(fds[1], &maxlv, sizeof(maxlv));
+    exit();
+  }
+  read(fds[0], &worst, sizeof(worst));
+  read(fds[0], &maxlv, sizeof(maxlv));
+  close(fds[0]);
+  close(fds[1]);
+  for (i = 0; i < NUM_HOG + 1; i++)
+    wait();
+
+  printf(1, "low-level process reached L%d, worst-case wait %d ticks\n",
+         maxlv, worst);
+  if (worst > 2 * BOOST_TICKS)
+    printf(1, "wrong: starved longer than two boost periods\n");
+}
+
 int main(int argc, char *argv[])
 {
   int i, pid;
@@ -258,6 +349,15 @@ int main(int argc, char *argv[])
   printf(1, "done\n");
   printf(1, "[Test 6] finished\n");
 
+  printf(1, "[Test 7] pick latency\n");
+  for (i = 0; i < sizeof(bench_procs) / sizeof(bench_procs[0]); i++)
+    pick_latency(bench_procs[i]);
+  printf(1, "[Test 7] finished\n");
+
+  printf(1, "[Test 8] starvation\n");
+  starvation();
+  printf(1, "[Test 8] finished\n");
+
   exit();
 }
 
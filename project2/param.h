@@ -10,5 +10,11 @@
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       2000  // size of file system in blocks
+#define NLEVEL       16  // maximum number of MLFQ levels
+#define NPTY         11  // number of setpriority() values (0..10)
+#define BOOSTTICKS  100  // default ticks between MLFQ priority boosts
+#define NTICKETS    100  // tickets shared by stride processes and MLFQ
+#define MAXTICKETS   80  // most tickets stride processes may hold
+#define TICKNS 10000000  // nanoseconds per timer tick (100Hz)
 
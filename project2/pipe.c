@@ -87,12 +87,12 @@ pipewrite(struct pipe *p, char *addr, int n)
         release(&p->lock);
         return -1;
       }
-      wakeup(&p->nread);
+      wakeupone(&p->nread);
       sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
     }
     p->data[p->nwrite++ % PIPESIZE] = addr[i];
   }
-  wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+  wakeupone(&p->nread);  //DOC: pipewrite-wakeup1
   release(&p->lock);
   return n;
 }
@@ -109,12 +109,22 @@ piperead(struct pipe *p, char *addr, int n)
       return -1;
     }
     sleep(&p->nread, &p->lock); //DOC: piperead-sleep
+    //killed after being chosen to read: leave the data, and
+    //the wakeup that came with it, to the other readers.
+    if(myproc()->killed && p->nread != p->nwrite){
+      wakeupone(&p->nread);
+      release(&p->lock);
+      return -1;
+    }
   }
   for(i = 0; i < n; i++){  //DOC: piperead-copy
     if(p->nread == p->nwrite)
       break;
     addr[i] = p->data[p->nread++ % PIPESIZE];
   }
+  //readers are woken one at a time; pass on what is left.
+  if(p->nread != p->nwrite)
+    wakeupone(&p->nread);
   wakeup(&p->nwrite);  //DOC: piperead-wakeup
   release(&p->lock);
   return i;
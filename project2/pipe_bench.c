@@ -0,0 +1,95 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NUM_PINGPONG 10000
+#define NUM_READER 4
+#define NUM_BYTE 10000
+
+// Pipe wakeup latency.
+// 1. One byte bounced between two processes NUM_PINGPONG times.
+// 2. NUM_READER readers blocked on one pipe while a writer sends
+//    NUM_BYTE single bytes; each byte should wake one reader,
+//    not all of them.
+
+void pingpong(void)
+{
+  int up[2], down[2];
+  int i, start, elapsed;
+  char c;
+
+  if (pipe(up) < 0 || pipe(down) < 0)
+  {
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  start = uptime();
+  if (fork() == 0)
+  {
+    for (i = 0; i < NUM_PINGPONG; i++)
+    {
+      read(down[0], &c, 1);
+      write(up[1], &c, 1);
+    }
+    exit();
+  }
+  c = 'x';
+  for (i = 0; i < NUM_PINGPONG; i++)
+  {
+    write(down[1], &c, 1);
+    read(up[0], &c, 1);
+  }
+  elapsed = uptime() - start;
+  wait();
+  close(up[0]);
+  close(up[1]);
+  close(down[0]);
+  close(down[1]);
+  // ticks are 10ms: us per round trip = ticks * 10000 / rounds
+  printf(1, "ping-pong: %d round trips in %d ticks, %d us each\n",
+         NUM_PINGPONG, elapsed, elapsed * 10000 / NUM_PINGPONG);
+}
+
+void fanout(void)
+{
+  int fd[2];
+  int i, n, start, elapsed;
+  char c;
+
+  if (pipe(fd) < 0)
+  {
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  for (i = 0; i < NUM_READER; i++)
+  {
+    if (fork() == 0)
+    {
+      close(fd[1]);
+      n = 0;
+      while (read(fd[0], &c, 1) == 1)
+        n++;
+      exit();
+    }
+  }
+  close(fd[0]);
+  start = uptime();
+  c = 'x';
+  for (i = 0; i < NUM_BYTE; i++)
+    write(fd[1], &c, 1);
+  close(fd[1]);
+  for (i = 0; i < NUM_READER; i++)
+    wait();
+  elapsed = uptime() - start;
+  printf(1, "fan-out: %d bytes to %d readers in %d ticks\n",
+         NUM_BYTE, NUM_READER, elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+  printf(1, "pipe bench start\n");
+  pingpong();
+  fanout();
+  printf(1, "pipe bench finished\n");
+  exit();
+}
@@ -4,16 +4,60 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
+#include "traps.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "pstat.h"
+#include "mlfq.h"
+
+// A FIFO of RUNNABLE processes linked through proc->next and proc->prev.
+struct runq {
+  struct proc *head;
+  struct proc *tail;
+};
+
+#if defined(MLFQ_SCHED) && K > NLEVEL
+#error "MLFQ_K is larger than NLEVEL"
+#endif
+
+#define STRIDE1 (1 << 20)  // stride of a single ticket
+#define RRTURNS 4          // RR picks a waiting FCFS process lets pass
+#define NSLEEPQ 64         // sleep queue buckets, a power of two
 
 struct {
   struct spinlock lock;
   struct proc proc[NPROC];
-  struct proc RR[NPROC];
-  struct proc FCFS[NPROC];
+  struct runq sleepq[NSLEEPQ];    // sleepers hashed by chan
+#ifdef MULTILEVEL_SCHED
+  struct runq RR;                 // even pids, round robin
+  struct runq FCFS;               // odd pids, sorted by pid
+  int rrturns;                    // RR picks since FCFS last ran
+#endif
+#ifdef MLFQ_SCHED
+  struct runq mlfq[NLEVEL][NPTY]; // ready queues by level and priority
+  uint lvmap;                     // bit lv set if level lv has a ready process
+  uint ptymap[NLEVEL];            // bit pty set if mlfq[lv][pty] is non-empty
+  uint epoch;                     // last boostepoch applied to the queues
+  int nlevel;                     // levels in use, see setmlfq()
+  int quantum[NLEVEL];            // time quantum of each level
+  struct proc *stride[NPROC];     // min-heap of ready stride processes by pass
+  int nstride;                    // processes in the stride heap
+  int tickets;                    // tickets held by stride processes
+  uint mlfqpass;                  // pass of the MLFQ class as a whole
+  uint vtime;                     // pass of the last pick
+#endif
 } ptable;
 
+#if !defined(MULTILEVEL_SCHED) && !defined(MLFQ_SCHED)
+// Per-CPU ready queue of the default scheduler.
+// Lock order: ptable.lock, then a cpurq lock.
+struct cpurq {
+  struct spinlock lock;
+  struct runq q;
+  int n;                       // Number of queued processes
+} cpurq[NCPU];
+#endif
+
 static struct proc *initproc;
 
 int nextpid = 1;
@@ -21,11 +65,28 @@ extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void setrunnable(struct proc *p);
+static int unqueue(struct proc *p);
+static void droptickets(struct proc *p);
+static struct runq *sleepq(void *chan);
+static void rqpush(struct runq *q, struct proc *p);
+static void rqremove(struct runq *q, struct proc *p);
 
 void
 pinit(void)
 {
   initlock(&ptable.lock, "ptable");
+#ifdef MLFQ_SCHED
+  int lv;
+  ptable.nlevel = K;
+  for(lv = 0; lv < NLEVEL; lv++)
+    ptable.quantum[lv] = lv*4 + 2;
+#endif
+#if !defined(MULTILEVEL_SCHED) && !defined(MLFQ_SCHED)
+  int i;
+  for(i = 0; i < NCPU; i++)
+    initlock(&cpurq[i].lock, "cpurq");
+#endif
 }
 // Must be called with interrupts disabled
 int
@@ -102,6 +163,11 @@ found:
   p->level = 0;
   p->pty = 0;
   p->ticks = 0;
+  p->tickets = 0;
+  p->utime = p->stime = 0;
+  p->nvcsw = p->nivcsw = 0;
+  p->waitticks = p->maxwait = 0;
+  memset(p->lvticks, 0, sizeof(p->lvticks));
 
   release(&ptable.lock);
 
@@ -162,7 +228,7 @@ userinit(void)
   // because the assignment might not be atomic.
   acquire(&ptable.lock);
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&ptable.lock);
 }
@@ -228,7 +294,7 @@ fork(void)
 
   acquire(&ptable.lock);
 
-  np->state = RUNNABLE;
+  setrunnable(np);
 
   release(&ptable.lock);
 
@@ -275,6 +341,8 @@ exit(void)
     }
   }
 
+  droptickets(curproc);
+
   // Jump into the scheduler, never to return.
   curproc->state = ZOMBIE;
   sched();
@@ -325,52 +393,509 @@ wait(void)
   }
 }
 
-//PAGEBREAK: 42
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run
-//  - swtch to start running that process
-//  - eventually that process transfers control
-//      via swtch back to the scheduler.
-int 
-checkRR(void)
+// Sleeping processes are off the run queues, so they use the
+// same links on the queue of their chan's bucket.
+static struct runq*
+sleepq(void *chan)
 {
-  struct proc * p;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid %2  == 0 && p->state == RUNNABLE)
-       return 1;
+  return &ptable.sleepq[(((uint)chan >> 2) * 2654435761u >> 16) & (NSLEEPQ-1)];
+}
+
+static void
+rqpush(struct runq *q, struct proc *p)
+{
+  p->next = 0;
+  p->prev = q->tail;
+  if(q->tail)
+    q->tail->next = p;
+  else
+    q->head = p;
+  q->tail = p;
+}
+
+static void
+rqremove(struct runq *q, struct proc *p)
+{
+  if(p->prev)
+    p->prev->next = p->next;
+  else
+    q->head = p->next;
+  if(p->next)
+    p->next->prev = p->prev;
+  else
+    q->tail = p->prev;
+  p->next = 0;
+  p->prev = 0;
+}
+
+#ifdef MLFQ_SCHED
+// Take a boost p has missed: a process that was queued when
+// priority_boosting() ran now sits on level 0, whatever p->level
+// says, and a sleeping one is boosted when it is queued again.
+// Also pulls p into range if setmlfq() dropped its level.
+static void
+boostcheck(struct proc *p)
+{
+  if(p->epoch != ptable.epoch){
+    p->epoch = ptable.epoch;
+    p->level = 0;
+    p->ticks = 0;
   }
-  return 0; 
+  if(p->level >= ptable.nlevel)
+    p->level = ptable.nlevel - 1;
 }
 
-void
+// Append p to the queue of its level and priority.
+static void
+mlfqpush(struct proc *p)
+{
+  boostcheck(p);
+  rqpush(&ptable.mlfq[p->level][p->pty], p);
+  ptable.ptymap[p->level] |= 1 << p->pty;
+  ptable.lvmap |= 1 << p->level;
+}
+
+static void
+mlfqremove(struct proc *p)
+{
+  struct runq *q;
+
+  boostcheck(p);
+  q = &ptable.mlfq[p->level][p->pty];
+  rqremove(q, p);
+  if(q->head == 0){
+    ptable.ptymap[p->level] &= ~(1 << p->pty);
+    if(ptable.ptymap[p->level] == 0)
+      ptable.lvmap &= ~(1 << p->level);
+  }
+}
+
+// The greatest priority process of the lowest non-empty level.
+static struct proc*
+mlfqpick(void)
+{
+  int lv;
+
+  if(ptable.lvmap == 0)
+    return 0;
+  lv = bsf(ptable.lvmap);
+  return ptable.mlfq[lv][bsr(ptable.ptymap[lv])].head;
+}
+
+static void
+rqsplice(struct runq *dst, struct runq *src)
+{
+  if(src->head == 0)
+    return;
+  if(dst->tail){
+    dst->tail->next = src->head;
+    src->head->prev = dst->tail;
+  } else
+    dst->head = src->head;
+  dst->tail = src->tail;
+  src->head = 0;
+  src->tail = 0;
+}
+
+// Apply the boosts the timer has announced since the last call
+// by moving every queue onto level 0. Costs NLEVEL*NPTY list
+// splices no matter how many processes there are; per-process
+// state is fixed up lazily by boostcheck().
+static void
 priority_boosting(void)
 {
-  struct proc * p;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state != RUNNABLE)
+  int lv, pty;
+  uint epoch = boostepoch;
+
+  if(ptable.epoch == epoch)
+    return;
+  for(lv = 1; lv < NLEVEL; lv++){
+    if((ptable.lvmap & (1 << lv)) == 0)
       continue;
-    p->level = 0;
-    p->ticks = 0;
+    for(pty = 0; pty < NPTY; pty++)
+      rqsplice(&ptable.mlfq[0][pty], &ptable.mlfq[lv][pty]);
+    ptable.ptymap[0] |= ptable.ptymap[lv];
+    ptable.ptymap[lv] = 0;
   }
+  if(ptable.lvmap)
+    ptable.lvmap = 1;
+  ptable.epoch = epoch;
 }
 
+// Passes wrap around; compare them by their difference.
+static int
+passbefore(uint a, uint b)
+{
+  return (int)(a - b) < 0;
+}
 
-int
-smallestQ(void)
+static void
+heapswap(int i, int j)
+{
+  struct proc *p = ptable.stride[i];
+
+  ptable.stride[i] = ptable.stride[j];
+  ptable.stride[j] = p;
+  ptable.stride[i]->stridx = i;
+  ptable.stride[j]->stridx = j;
+}
+
+static void
+siftup(int i)
+{
+  while(i > 0 && passbefore(ptable.stride[i]->pass,
+                            ptable.stride[(i-1)/2]->pass)){
+    heapswap(i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+static void
+siftdown(int i)
+{
+  int c, min;
+
+  for(;;){
+    min = i;
+    for(c = 2*i + 1; c <= 2*i + 2 && c < ptable.nstride; c++)
+      if(passbefore(ptable.stride[c]->pass, ptable.stride[min]->pass))
+        min = c;
+    if(min == i)
+      return;
+    heapswap(i, min);
+    i = min;
+  }
+}
+
+// Add p to the stride heap. A process that slept or just joined
+// starts at the current virtual time, so it cannot spend the
+// share it did not use while away.
+static void
+stridepush(struct proc *p)
+{
+  if(passbefore(p->pass, ptable.vtime))
+    p->pass = ptable.vtime;
+  p->stridx = ptable.nstride++;
+  ptable.stride[p->stridx] = p;
+  siftup(p->stridx);
+}
+
+static void
+strideremove(struct proc *p)
+{
+  int i = p->stridx;
+
+  if(i != --ptable.nstride){
+    ptable.stride[i] = ptable.stride[ptable.nstride];
+    ptable.stride[i]->stridx = i;
+    siftdown(i);
+    siftup(i);
+  }
+}
+
+// Stride processes and the MLFQ class compete by pass: the MLFQ
+// class is one more participant holding the tickets nobody
+// reserved, and inside its share the MLFQ rules apply as before.
+static void
+classpush(struct proc *p)
+{
+  if(p->tickets){
+    stridepush(p);
+    return;
+  }
+  //an MLFQ class coming back from empty starts at the virtual time too.
+  if(ptable.lvmap == 0 && passbefore(ptable.mlfqpass, ptable.vtime))
+    ptable.mlfqpass = ptable.vtime;
+  mlfqpush(p);
+}
+
+static void
+classremove(struct proc *p)
+{
+  if(p->tickets)
+    strideremove(p);
+  else
+    mlfqremove(p);
+}
+
+// The stride process with the smallest pass, unless the MLFQ
+// class is further behind; then MLFQ picks as usual.
+static struct proc*
+classpick(void)
+{
+  struct proc *s, *m;
+
+  s = ptable.nstride ? ptable.stride[0] : 0;
+  m = mlfqpick();
+  if(s && (m == 0 || passbefore(s->pass, ptable.mlfqpass))){
+    ptable.vtime = s->pass;
+    return s;
+  }
+  if(m)
+    ptable.vtime = ptable.mlfqpass;
+  return m;
+}
+
+#elif !defined(MULTILEVEL_SCHED)
+// Append p to the ready queue of the CPU it last ran on.
+static void
+cpupush(struct proc *p)
+{
+  struct cpurq *rq = &cpurq[p->cpu];
+
+  acquire(&rq->lock);
+  rqpush(&rq->q, p);
+  rq->n++;
+  release(&rq->lock);
+}
+
+// Take the process that has waited longest off rq, if any.
+static struct proc*
+cpupop(struct cpurq *rq)
 {
   struct proc *p;
-  int lv = 5;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state != RUNNABLE)
-      continue;
-    if(p->level < lv)
-      lv = p->level;
+
+  acquire(&rq->lock);
+  if((p = rq->q.head) != 0){
+    rqremove(&rq->q, p);
+    rq->n--;
+  }
+  release(&rq->lock);
+  return p;
+}
+
+// Remove p from its CPU's queue. Returns 0 if a scheduler
+// has already popped it and is about to run it.
+static int
+cpuremove(struct proc *p)
+{
+  struct cpurq *rq = &cpurq[p->cpu];
+  int queued;
+
+  acquire(&rq->lock);
+  if((queued = (p->prev != 0 || rq->q.head == p)) != 0){
+    rqremove(&rq->q, p);
+    rq->n--;
+  }
+  release(&rq->lock);
+  return queued;
+}
+
+// Steal from the CPU with the longest ready queue.
+// The lengths are read without locks; cpupop rechecks.
+static struct proc*
+steal(int self)
+{
+  int i, n, most = 0;
+  struct cpurq *busiest = 0;
+
+  for(i = 0; i < ncpu; i++){
+    n = cpurq[i].n;
+    if(i != self && n > most){
+      most = n;
+      busiest = &cpurq[i];
+    }
+  }
+  if(busiest == 0)
+    return 0;
+  return cpupop(busiest);
+}
+
+// CPU with the shortest ready queue, for new processes.
+static int
+leastloaded(void)
+{
+  int i, best = 0;
+
+  for(i = 1; i < ncpu; i++)
+    if(cpurq[i].n < cpurq[best].n)
+      best = i;
+  return best;
+}
+
+#else
+// Even pids go round robin on RR, odd pids first come first
+// served on FCFS: the smallest pid runs until it blocks.
+static void
+mlpush(struct proc *p)
+{
+  struct runq *q = &ptable.FCFS;
+  struct proc *at;
+
+  if(p->pid % 2 == 0){
+    rqpush(&ptable.RR, p);
+    return;
+  }
+  //new processes have the largest pid, so most inserts stop at once.
+  for(at = q->tail; at && at->pid > p->pid; at = at->prev)
+    ;
+  p->prev = at;
+  p->next = at ? at->next : q->head;
+  if(p->next)
+    p->next->prev = p;
+  else
+    q->tail = p;
+  if(at)
+    at->next = p;
+  else
+    q->head = p;
+}
+
+static void
+mlremove(struct proc *p)
+{
+  rqremove(p->pid % 2 == 0 ? &ptable.RR : &ptable.FCFS, p);
+}
+
+// RR goes first, but a waiting FCFS process gets a turn
+// after RRTURNS RR picks so it cannot starve.
+static struct proc*
+mlpick(void)
+{
+  struct proc *rr = ptable.RR.head, *fcfs = ptable.FCFS.head;
+
+  if(rr && (fcfs == 0 || ptable.rrturns < RRTURNS)){
+    if(fcfs)
+      ptable.rrturns++;
+    return rr;
+  }
+  ptable.rrturns = 0;
+  return fcfs;
+}
+#endif
+
+// Is there anything this CPU could run?
+// Read without locks; a wrong answer costs at most one tick.
+static int
+haswork(int self)
+{
+#ifdef MLFQ_SCHED
+  return ptable.lvmap != 0 || ptable.nstride != 0;
+#elif !defined(MULTILEVEL_SCHED)
+  int i;
+
+  for(i = 0; i < ncpu; i++)
+    if(cpurq[i].n > 0)
+      return 1;
+  return 0;
+#else
+  return ptable.RR.head != 0 || ptable.FCFS.head != 0;
+#endif
+}
+
+// Is other work queued that this CPU might run? An unlocked
+// hint for busy waits that should give the CPU up.
+int
+needresched(void)
+{
+#ifdef MLFQ_SCHED
+  return ptable.lvmap != 0 || ptable.nstride != 0;
+#elif !defined(MULTILEVEL_SCHED)
+  int self;
+
+  pushcli();
+  self = cpuid();
+  popcli();
+  return cpurq[self].n > 0;
+#else
+  return ptable.RR.head != 0 || ptable.FCFS.head != 0;
+#endif
+}
+
+// Nothing to run: halt until the next interrupt instead of
+// spinning on the ready queues. The timer tick or an IRQ_WAKEUP
+// from kick() brings the CPU back.
+static void
+idle(struct cpu *c)
+{
+  cli();
+  // xchg orders the store to c->idle before the reads in
+  // haswork(), so a waker either sees idle set or we see its work.
+  xchg(&c->idle, 1);
+  if(!haswork(c - cpus)){
+    c->halts++;
+    stihlt();
   }
-  return lv;
+  c->idle = 0;
+}
+
+// Make sure some CPU notices newly queued work: the CPU that
+// owns the queue if it is halted, else any other halted CPU.
+static void
+kick(int target)
+{
+  int i;
+
+  if(target >= 0 && !cpus[target].idle)
+    target = -1;
+  for(i = 0; target < 0 && i < ncpu; i++)
+    if(cpus[i].idle)
+      target = i;
+  if(target >= 0)
+    lapicipi(cpus[target].apicid, T_IRQ0 + IRQ_WAKEUP);
+}
+
+// Mark p RUNNABLE and put it on the ready queue.
+// The ptable lock must be held.
+static void
+setrunnable(struct proc *p)
+{
+  p->readyat = ticks;
+#ifdef MLFQ_SCHED
+  p->state = RUNNABLE;
+  classpush(p);
+  kick(-1);
+#elif !defined(MULTILEVEL_SCHED)
+  //a new process goes to the least loaded CPU,
+  //a woken one back to the CPU it last ran on.
+  if(p->state == EMBRYO)
+    p->cpu = leastloaded();
+  p->state = RUNNABLE;
+  cpupush(p);
+  kick(p->cpu);
+#else
+  p->state = RUNNABLE;
+  mlpush(p);
+  kick(-1);
+#endif
+}
+
+// Take a RUNNABLE p off the ready queue. Returns 0 if p
+// was not queued because a scheduler is about to run it.
+// The ptable lock must be held.
+static int
+unqueue(struct proc *p)
+{
+#ifdef MLFQ_SCHED
+  classremove(p);
+  return 1;
+#elif !defined(MULTILEVEL_SCHED)
+  return cpuremove(p);
+#else
+  mlremove(p);
+  return 1;
+#endif
 }
 
+// p is about to run: charge the time it waited for a CPU.
+static void
+dispatched(struct proc *p)
+{
+  uint w = ticks - p->readyat;
+
+  p->waitticks += w;
+  if(w > p->maxwait)
+    p->maxwait = w;
+}
+
+//PAGEBREAK: 42
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - choose a process to run
+//  - swtch to start running that process
+//  - eventually that process transfers control
+//      via swtch back to the scheduler.
 #ifdef MULTILEVEL_SCHED
 void
 scheduler(void)
@@ -383,45 +908,23 @@ scheduler(void)
     // Enable interrupts on this processor.
     
     sti();
-    // Loop over process table looking for process to run.
     acquire(&ptable.lock);
-    struct proc *tmp = 0;
-    int pid = 10000;
-   
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->pid %2 ==0 &&p->state == RUNNABLE){
-        c->proc = p;
-        switchuvm(p);
-        p->state = RUNNING;
-
-        swtch(&(c->scheduler), p->context);
-        switchkvm();
-
-        c->proc = 0;
-      }
-    }
-
-    int check;
-    check = checkRR();
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(check == 1)
-	      break;
-      if(p->state != RUNNABLE)
-	      continue;
-      if(p->pid< pid && p->pid > 0){
-        tmp = p;
-        pid = p->pid;
-      }
-    }
-    if(tmp){
-      c -> proc = tmp;
-      switchuvm(tmp);
-      tmp->state = RUNNING;
-      swtch(&(c->scheduler), tmp->context);
+    if((p = mlpick()) != 0){
+      mlremove(p);
+      c->proc = p;
+      switchuvm(p);
+      p->state = RUNNING;
+      dispatched(p);
+      swtch(&(c->scheduler), p->context);
       switchkvm();
-      c->proc=0;
+      c->proc = 0;
+      //RR goes to the back of its queue, FCFS back to its place.
+      if(p->state == RUNNABLE)
+        mlpush(p);
     }
     release(&ptable.lock);
+    if(p == 0)
+      idle(c);
   }
 }
 
@@ -433,49 +936,44 @@ scheduler(void)
 
   struct cpu *c = mycpu();
   c->proc = 0;
-  int startTime = uptime();
 
   for(;;){
     // Enable interrupts on this processor.
     
     sti();
-    // Loop over process table looking for process to run.
     acquire(&ptable.lock);
-    struct proc *tmp = 0;
-    int pty = -1; 
-    int currentlv = smallestQ();
+    priority_boosting();
     //select the greatest priority Process of the lowest queue.
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      //process that not runnable or running won't be considered
-      if(p->state != RUNNABLE && p->state != RUNNING)
-	      continue;
-      if(p->level != currentlv || currentlv >= K)
-        continue;
-      else if(p->pty > pty && p->pid > 0){
-        tmp = p;
-        pty = p->pty;
-      }
-    }
-    //tmp contains smallest queue, biggest priority
-    if(tmp){
-
-      c -> proc = tmp;
-      switchuvm(tmp);
-      tmp->state = RUNNING;
-      tmp->ticks += 1;
-      swtch(&(c->scheduler), tmp->context);
+    if((p = classpick()) != 0){
+      classremove(p);
+      c -> proc = p;
+      switchuvm(p);
+      p->state = RUNNING;
+      dispatched(p);
+      p->ticks += 1;
+      swtch(&(c->scheduler), p->context);
       switchkvm();
       c->proc=0;
-      if(tmp->ticks >= (currentlv*4 + 2)){
-        tmp->ticks = 0;
-        tmp->level++;
+      //charge the tick to p's class.
+      if(p->tickets)
+        p->pass += STRIDE1 / p->tickets;
+      else {
+        ptable.mlfqpass += STRIDE1 / (NTICKETS - ptable.tickets);
+        boostcheck(p);
+        if(p->ticks >= ptable.quantum[p->level]){
+          p->ticks = 0;
+          if(p->level < ptable.nlevel - 1)
+            p->level++;
+        }
       }
-    }
-    if(uptime() >= 100 + startTime){
-      priority_boosting();
-      startTime = uptime();
+      //yield() leaves p RUNNABLE but off the queues until its
+      //context is saved; requeue it at its (possibly new) level.
+      if(p->state == RUNNABLE)
+        classpush(p);
     }
     release(&ptable.lock);
+    if(p == 0)
+      idle(c);
   }
 }
 
@@ -485,26 +983,32 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int self = c - cpus;
   c->proc = 0;
   for(;;){
     // Enable interrupts on this processor.
     
     sti();
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
+    // Take from this CPU's queue; steal only when it is empty.
+    // Neither touches ptable.lock.
+    if((p = cpupop(&cpurq[self])) == 0 && (p = steal(self)) == 0){
+      idle(c);
+      continue;
+    }
 
-   
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
-      //ptable.RR[idxR] = *pr;
-      //idxR ++;
+    acquire(&ptable.lock);
+    // p may have been killed after it left the queue, and
+    // its slot even reused and queued again by fork().
+    if(p->state == RUNNABLE){
+      cpuremove(p);
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
       // before jumping back to us.
+      p->cpu = self;
       c->proc = p;
       switchuvm(p);
       p->state = RUNNING;
+      dispatched(p);
 
       swtch(&(c->scheduler), p->context);
       switchkvm();
@@ -512,8 +1016,9 @@ scheduler(void)
       // Process is done running for now.
       // It should have changed its p->state before coming back.
       c->proc = 0;
+      if(p->state == RUNNABLE)
+        cpupush(p);
     }
-
     release(&ptable.lock);
   }
 }
@@ -524,21 +1029,129 @@ int
 setpriority(int pid, int pty)
 {
   struct proc *p;
+  int queued;
+  acquire(&ptable.lock);
   for(p= ptable.proc; p<&ptable.proc[NPROC];p++){
     if(p->pid==pid&&p->parent->pid == myproc()->pid){
+      //a queued process moves to the queue of its new priority.
+      queued = p->state == RUNNABLE && unqueue(p);
       p->pty = pty;
+      if(queued)
+        setrunnable(p);
+      release(&ptable.lock);
       return 0;
     }
   }
+  release(&ptable.lock);
   return -1;
 }
 
 int
 getlev(void)
 {
+#ifdef MLFQ_SCHED
+  //a boost that has not reached this process yet still counts.
+  if(myproc()->epoch != ptable.epoch)
+    return 0;
+#endif
   return myproc()->level;
 }
 
+// Give back p's stride tickets. The ptable lock must be held.
+static void
+droptickets(struct proc *p)
+{
+#ifdef MLFQ_SCHED
+  ptable.tickets -= p->tickets;
+#endif
+  p->tickets = 0;
+}
+
+// Move the caller into the stride class with a fixed share of
+// tickets out of NTICKETS, or back to MLFQ with 0 tickets.
+// Fails if stride processes would hold more than MAXTICKETS.
+int
+settickets(int tickets)
+{
+#ifdef MLFQ_SCHED
+  struct proc *p = myproc();
+
+  if(tickets < 0)
+    return -1;
+  acquire(&ptable.lock);
+  if(ptable.tickets - p->tickets + tickets > MAXTICKETS){
+    release(&ptable.lock);
+    return -1;
+  }
+  ptable.tickets += tickets - p->tickets;
+  p->tickets = tickets;
+  p->pass = ptable.vtime;
+  release(&ptable.lock);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+int
+getmlfq(struct mlfqconf *mc)
+{
+#ifdef MLFQ_SCHED
+  int lv;
+
+  acquire(&ptable.lock);
+  mc->nlevel = ptable.nlevel;
+  for(lv = 0; lv < NLEVEL; lv++)
+    mc->quantum[lv] = ptable.quantum[lv];
+  mc->boost = boostperiod;
+  release(&ptable.lock);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+// Replace the level count, quantum table and boost period.
+// Processes queued on levels that go away move to the new
+// last level, all under ptable.lock so no pick sees a mix.
+int
+setmlfq(struct mlfqconf *mc)
+{
+#ifdef MLFQ_SCHED
+  struct proc *p;
+  int lv, pty, last;
+
+  if(mc->nlevel < 1 || mc->nlevel > NLEVEL || mc->boost < 0)
+    return -1;
+  for(lv = 0; lv < mc->nlevel; lv++)
+    if(mc->quantum[lv] < 1)
+      return -1;
+
+  acquire(&ptable.lock);
+  last = mc->nlevel - 1;
+  for(lv = mc->nlevel; lv < NLEVEL; lv++){
+    if((ptable.lvmap & (1 << lv)) == 0)
+      continue;
+    for(pty = 0; pty < NPTY; pty++){
+      for(p = ptable.mlfq[lv][pty].head; p; p = p->next)
+        p->level = last;
+      rqsplice(&ptable.mlfq[last][pty], &ptable.mlfq[lv][pty]);
+    }
+    ptable.ptymap[last] |= ptable.ptymap[lv];
+    ptable.ptymap[lv] = 0;
+    ptable.lvmap = (ptable.lvmap & ~(1 << lv)) | (1 << last);
+  }
+  ptable.nlevel = mc->nlevel;
+  for(lv = 0; lv < NLEVEL; lv++)
+    ptable.quantum[lv] = lv < mc->nlevel ? mc->quantum[lv] : 0;
+  boostperiod = mc->boost;
+  release(&ptable.lock);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
 // Enter scheduler.  Must hold only ptable.lock
 // and have changed proc->state. Saves and restores
 // intena because intena is a property of this
@@ -571,6 +1184,7 @@ yield(void)
 {
   acquire(&ptable.lock);  //DOC: yieldlock
   myproc()->state = RUNNABLE;
+  myproc()->readyat = ticks;
   sched();
   release(&ptable.lock);
 }
@@ -622,6 +1236,8 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->nvcsw++;
+  rqpush(sleepq(chan), p);
 
   sched();
 
@@ -641,11 +1257,16 @@ sleep(void *chan, struct spinlock *lk)
 static void
 wakeup1(void *chan)
 {
-  struct proc *p;
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
-      p->state = RUNNABLE;
+  struct runq *q = sleepq(chan);
+  struct proc *p, *next;
+
+  for(p = q->head; p; p = next){
+    next = p->next;
+    if(p->chan == chan){
+      rqremove(q, p);
+      setrunnable(p);
+    }
+  }
 }
 
 // Wake up all processes sleeping on chan.
@@ -657,6 +1278,26 @@ wakeup(void *chan)
   release(&ptable.lock);
 }
 
+// Wake up the process that has slept longest on chan.
+// For waiters that each consume what they wait for: the one
+// woken passes the wakeup on if something is left over.
+void
+wakeupone(void *chan)
+{
+  struct runq *q = sleepq(chan);
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  for(p = q->head; p; p = p->next){
+    if(p->chan == chan){
+      rqremove(q, p);
+      setrunnable(p);
+      break;
+    }
+  }
+  release(&ptable.lock);
+}
+
 // Kill the process with the given pid.
 // Process won't exit until it returns
 // to user space (see trap in trap.c).
@@ -670,8 +1311,10 @@ kill(int pid)
     if(p->pid == pid){
       p->killed = 1;
       // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-        p->state = RUNNABLE;
+      if(p->state == SLEEPING){
+        rqremove(sleepq(p->chan), p);
+        setrunnable(p);
+      }
       release(&ptable.lock);
       return 0;
     }
@@ -680,6 +1323,57 @@ kill(int pid)
   return -1;
 }
 
+// Copy the idle counters of up to n CPUs into cs.
+// Returns the number of CPUs.
+int
+getcpustat(struct cpustat *cs, int n)
+{
+  int i;
+
+  for(i = 0; i < n && i < ncpu; i++){
+    cs[i].ticks = cpus[i].ticks;
+    cs[i].idleticks = cpus[i].idleticks;
+    cs[i].halts = cpus[i].halts;
+  }
+  return ncpu;
+}
+
+// Copy the statistics of up to n processes into ps.
+// Returns the number copied.
+int
+getpinfo(struct pstat *ps, int n)
+{
+  struct proc *p;
+  int i = 0;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC] && i < n; p++){
+    if(p->state == UNUSED)
+      continue;
+    ps[i].pid = p->pid;
+    ps[i].tid = -1;
+    ps[i].state = p->state;
+    safestrcpy(ps[i].name, p->name, sizeof(ps[i].name));
+    ps[i].level = p->level;
+#ifdef MLFQ_SCHED
+    if(p->epoch != ptable.epoch)
+      ps[i].level = 0;
+#endif
+    ps[i].pty = p->pty;
+    ps[i].tickets = p->tickets;
+    ps[i].utime = p->utime;
+    ps[i].stime = p->stime;
+    ps[i].nvcsw = p->nvcsw;
+    ps[i].nivcsw = p->nivcsw;
+    ps[i].waitticks = p->waitticks;
+    ps[i].maxwait = p->maxwait;
+    memmove(ps[i].lvticks, p->lvticks, sizeof(ps[i].lvticks));
+    i++;
+  }
+  release(&ptable.lock);
+  return i;
+}
+
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
@@ -707,7 +1401,8 @@ procdump(void)
       state = states[p->state];
     else
       state = "???";
-    cprintf("%d %s %s", p->pid, state, p->name);
+    cprintf("%d %s %s u%d s%d w%d", p->pid, state, p->name,
+            p->utime, p->stime, p->waitticks);
     if(p->state == SLEEPING){
       getcallerpcs((uint*)p->context->ebp+2, pc);
       for(i=0; i<10 && pc[i] != 0; i++)
@@ -8,6 +8,10 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  volatile uint idle;          // Halted in the scheduler's idle loop?
+  uint ticks;                  // Timer interrupts taken
+  uint idleticks;              // Timer interrupts that found the cpu idle
+  uint halts;                  // Times the idle loop halted
 };
 
 extern struct cpu cpus[NCPU];
@@ -34,6 +38,15 @@ struct context {
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A deadline on the timer wheel, see timer.c.
+struct timer {
+  uint expires;                // Tick to fire at
+  void *chan;                  // wakeup() channel when it fires
+  struct timer *next;          // Next timer in the slot
+  struct timer *prev;          // Previous timer in the slot
+  struct timer **slot;         // Slot it is filed in, 0 if not pending
+};
+
 // Per-process state
 struct proc {
   uint sz;                     // Size of process memory (bytes)
@@ -50,10 +63,24 @@ struct proc {
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
   struct proc * next;          // Next Process in queue
+  struct proc * prev;          // Previous Process in queue
+  int cpu;                     // CPU this process last ran on
   int pty;		                 // process priority
   int level;		               // queue level
   int ticks;                   // time quantum
-  int time;                    // real time
+  uint epoch;                  // boost epoch level and ticks belong to
+  int tickets;                 // stride tickets, 0 if scheduled by MLFQ
+  uint pass;                   // stride pass value
+  int stridx;                  // index in the stride heap
+  uint utime;                  // Timer ticks taken in user mode
+  uint stime;                  // Timer ticks taken in the kernel
+  uint nvcsw;                  // Voluntary context switches
+  uint nivcsw;                 // Involuntary context switches
+  uint readyat;                // ticks when last made RUNNABLE
+  uint waitticks;              // Ticks spent RUNNABLE before dispatch
+  uint maxwait;                // Longest single wait for a CPU
+  uint lvticks[NLEVEL];        // Ticks taken at each MLFQ level
+  struct timer timer;          // Wakes sleepers in sleepuntil()
 };
 
 // Process memory is laid out contiguously, low addresses first:
@@ -0,0 +1,24 @@
+// Scheduler statistics returned by getcpustat().
+struct cpustat {
+  uint ticks;      // Timer interrupts taken
+  uint idleticks;  // Timer interrupts that found the cpu idle
+  uint halts;      // Times the idle loop halted
+};
+
+// Per-process statistics returned by getpinfo().
+struct pstat {
+  int pid;
+  int tid;               // -1 for a process, else its thread id
+  int state;             // enum procstate
+  char name[16];
+  int level;             // Current MLFQ level
+  int pty;
+  int tickets;           // Stride tickets, 0 under MLFQ
+  uint utime;            // Timer ticks taken in user mode
+  uint stime;            // Timer ticks taken in the kernel
+  uint nvcsw;            // Voluntary context switches
+  uint nivcsw;           // Involuntary context switches
+  uint waitticks;        // Ticks spent RUNNABLE before dispatch
+  uint maxwait;          // Longest single wait for a CPU
+  uint lvticks[NLEVEL];  // Ticks taken at each MLFQ level
+};
@@ -108,6 +108,12 @@ extern int sys_getppid(void);
 extern int sys_yield(void);
 extern int sys_setpriority(void);
 extern int sys_getlev(void);
+extern int sys_getcpustat(void);
+extern int sys_getmlfq(void);
+extern int sys_setmlfq(void);
+extern int sys_settickets(void);
+extern int sys_getpinfo(void);
+extern int sys_nanosleep(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -135,7 +141,13 @@ static int (*syscalls[])(void) = {
 [SYS_getppid] sys_getppid,
 [SYS_yield] sys_yield,
 [SYS_setpriority] sys_setpriority,
-[SYS_getlev]  sys_getlev
+[SYS_getlev]  sys_getlev,
+[SYS_getcpustat] sys_getcpustat,
+[SYS_getmlfq] sys_getmlfq,
+[SYS_setmlfq] sys_setmlfq,
+[SYS_settickets] sys_settickets,
+[SYS_getpinfo] sys_getpinfo,
+[SYS_nanosleep] sys_nanosleep,
 };
 
 void
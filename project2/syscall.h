@@ -25,3 +25,9 @@
 #define SYS_yield 24
 #define SYS_setpriority 25
 #define SYS_getlev 26
+#define SYS_getcpustat 27
+#define SYS_getmlfq 28
+#define SYS_setmlfq 29
+#define SYS_settickets 30
+#define SYS_getpinfo 31
+#define SYS_nanosleep 32
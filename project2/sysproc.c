@@ -6,6 +6,8 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "pstat.h"
+#include "mlfq.h"
 
 int
 sys_fork(void)
@@ -65,13 +67,9 @@ sys_sleep(void)
     return -1;
   acquire(&tickslock);
   ticks0 = ticks;
-
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
+  if(sleepuntil(ticks0 + n) < 0){
+    release(&tickslock);
+    return -1;
   }
   release(&tickslock);
   myproc()->ticks = 0;
@@ -81,6 +79,30 @@ sys_sleep(void)
 
 // return how many clock tick interrupts have occurred
 // since start.
+// Whole ticks are slept on the timer wheel, the remainder
+// spun on the lapic timer with interrupts on.
+int
+sys_nanosleep(void)
+{
+  int sec, nsec;
+
+  if(argint(0, &sec) < 0 || argint(1, &nsec) < 0)
+    return -1;
+  if(sec < 0 || nsec < 0 || nsec >= 1000000000)
+    return -1;
+  //the deadline must stay less than 2^31 ticks away.
+  if(sec >= 0x7fffffff / (1000000000/TICKNS))
+    return -1;
+  acquire(&tickslock);
+  if(sleepuntil(ticks + sec*(1000000000/TICKNS) + nsec/TICKNS) < 0){
+    release(&tickslock);
+    return -1;
+  }
+  release(&tickslock);
+  lapicspin(nsec % TICKNS);
+  return 0;
+}
+
 int
 sys_uptime(void)
 {
@@ -98,6 +120,7 @@ sys_yield(void)
   if(myproc()->state == RUNNING){
     myproc()->ticks = 0;
     myproc()->level = 0;
+    myproc()->nvcsw++;
 
   	yield();
   }
@@ -125,3 +148,64 @@ int
 sys_getlev(void){
   return getlev();
 }
+
+int
+sys_getmlfq(void)
+{
+  struct mlfqconf *mc;
+
+  if(argptr(0, (char**)&mc, sizeof(*mc)) < 0)
+    return -1;
+  return getmlfq(mc);
+}
+
+int
+sys_setmlfq(void)
+{
+  struct mlfqconf *mc;
+
+  if(argptr(0, (char**)&mc, sizeof(*mc)) < 0)
+    return -1;
+  return setmlfq(mc);
+}
+
+int
+sys_settickets(void)
+{
+  int tickets;
+
+  if(argint(0, &tickets) < 0)
+    return -1;
+  return settickets(tickets);
+}
+
+int
+sys_getcpustat(void)
+{
+  struct cpustat *cs;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NCPU)
+    n = NCPU;
+  if(argptr(0, (char**)&cs, n*sizeof(*cs)) < 0)
+    return -1;
+  return getcpustat(cs, n);
+}
+
+int
+sys_getpinfo(void)
+{
+  struct pstat *ps;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  //getpinfo() never fills more, and a larger n could overflow.
+  if(n > NPROC)
+    n = NPROC;
+  if(argptr(0, (char**)&ps, n*sizeof(*ps)) < 0)
+    return -1;
+  return getpinfo(ps, n);
+}
@@ -0,0 +1,76 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "pstat.h"
+
+// Sample per-process CPU use and run-queue waits.
+// usage: top [ticks] [rounds]
+// Every line covers the last sample period: CPU is the share of
+// one CPU, USR/SYS/WAIT are ticks, VCSW/IVCSW are switches.
+// Ticks taken at each MLFQ level are cumulative.
+
+char *states[] = {"unused", "embryo", "sleep", "runble", "run", "zombie"};
+
+struct pstat before[NPROC], after[NPROC];
+
+// Earlier sample of the same process or thread, if any.
+struct pstat *find(struct pstat *ps, int n, struct pstat *p)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (ps[i].pid == p->pid && ps[i].tid == p->tid)
+      return &ps[i];
+  return 0;
+}
+
+void show(struct pstat *p, struct pstat *old, int period)
+{
+  struct pstat zero;
+  int lv, used;
+
+  if (old == 0)
+  {
+    memset(&zero, 0, sizeof(zero));
+    old = &zero;
+  }
+  used = p->utime - old->utime + p->stime - old->stime;
+  printf(1, "%d %d %s %s lv%d cpu %d%% usr %d sys %d vcsw %d ivcsw %d "
+            "wait %d maxwait %d",
+         p->pid, p->tid, p->name, states[p->state], p->level,
+         used * 100 / period, p->utime - old->utime, p->stime - old->stime,
+         p->nvcsw - old->nvcsw, p->nivcsw - old->nivcsw,
+         p->waitticks - old->waitticks, p->maxwait);
+  for (lv = 0; lv < NLEVEL; lv++)
+    if (p->lvticks[lv])
+      printf(1, " L%d:%d", lv, p->lvticks[lv]);
+  printf(1, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+  int i, n, m, period, rounds;
+
+  period = 100;
+  rounds = 1;
+  if (argc > 1)
+    period = atoi(argv[1]);
+  if (argc > 2)
+    rounds = atoi(argv[2]);
+  if (period <= 0)
+    period = 1;
+
+  n = getpinfo(before, NPROC);
+  while (rounds-- > 0)
+  {
+    sleep(period);
+    m = getpinfo(after, NPROC);
+    printf(1, "PID TID NAME STATE LEVEL\n");
+    for (i = 0; i < m; i++)
+      show(&after[i], find(before, n, &after[i]), period);
+    memmove(before, after, sizeof(after));
+    n = m;
+  }
+  exit();
+}
@@ -13,6 +13,8 @@ struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
+volatile uint boostepoch;  // bumped every boostperiod; see priority_boosting
+volatile uint boostperiod = BOOSTTICKS;
 
 void
 tvinit(void)
@@ -57,9 +59,26 @@ trap(struct trapframe *tf)
     if(cpuid() == 0){
       acquire(&tickslock);
       ticks++;
-      wakeup(&ticks);
+      if(boostperiod && ticks % boostperiod == 0)
+        boostepoch++;
+      timertick();
       release(&tickslock);
     }
+    mycpu()->ticks++;
+    if(mycpu()->idle)
+      mycpu()->idleticks++;
+    //charge the tick to whoever it interrupted.
+    if(myproc() && myproc()->state == RUNNING){
+      if((tf->cs&3) == DPL_USER)
+        myproc()->utime++;
+      else
+        myproc()->stime++;
+      myproc()->lvticks[myproc()->level]++;
+    }
+    lapiceoi();
+    break;
+  case T_IRQ0 + IRQ_WAKEUP:
+    // Only has to end the hlt in the idle loop.
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -109,8 +128,10 @@ trap(struct trapframe *tf)
   // Force process to give up CPU on clock tick.
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     tf->trapno == T_IRQ0+IRQ_TIMER){
+    myproc()->nivcsw++;
     yield();
+  }
 
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
@@ -1,5 +1,8 @@
 struct stat;
 struct rtcdate;
+struct cpustat;
+struct mlfqconf;
+struct pstat;
 
 // system calls
 int fork(void);
@@ -28,6 +31,12 @@ int getppid(void);
 int yield(void);
 int setpriority(int, int);
 int getlev(void);
+int getcpustat(struct cpustat*, int);
+int getmlfq(struct mlfqconf*);
+int setmlfq(struct mlfqconf*);
+int settickets(int);
+int getpinfo(struct pstat*, int);
+int nanosleep(int, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
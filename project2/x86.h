@@ -117,6 +117,15 @@ sti(void)
   asm volatile("sti");
 }
 
+// Enable interrupts and halt until the next one arrives.
+// sti takes effect only after hlt has started, so an
+// interrupt cannot slip in between and be missed.
+static inline void
+stihlt(void)
+{
+  asm volatile("sti; hlt");
+}
+
 static inline uint
 xchg(volatile uint *addr, uint newval)
 {
@@ -130,6 +139,24 @@ xchg(volatile uint *addr, uint newval)
   return result;
 }
 
+// Index of the lowest set bit in v. v must not be zero.
+static inline uint
+bsf(uint v)
+{
+  uint r;
+  asm volatile("bsfl %1,%0" : "=r" (r) : "rm" (v) : "cc");
+  return r;
+}
+
+// Index of the highest set bit in v. v must not be zero.
+static inline uint
+bsr(uint v)
+{
+  uint r;
+  asm volatile("bsrl %1,%0" : "=r" (r) : "rm" (v) : "cc");
+  return r;
+}
+
 static inline uint
 rcr2(void)
 {
@@ -0,0 +1,118 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NUM_THREAD 4
+#define NUM_CHECK 2000
+
+// Threads pinned to one CPU must only ever be seen running on
+// it, through yields, sleeps and preemption. Run with CPUS > 1
+// for the test to mean anything.
+
+thread_t thread[NUM_THREAD];
+int ncpu;
+int strays[NUM_THREAD];
+
+// Check getcpu() NUM_CHECK times against mask.
+int stray(uint mask)
+{
+  volatile int j;
+  int i, n;
+
+  n = 0;
+  for (i = 0; i < NUM_CHECK; i++)
+  {
+    if (((mask >> getcpu()) & 1) == 0)
+      n++;
+    if (i % 100 == 0)
+      yield();
+    else if (i % 500 == 1)
+      sleep(1);
+    for (j = 0; j < 1000; j++)
+      ;
+  }
+  return n;
+}
+
+// Pin this thread to CPU arg % ncpu.
+void *pinned(void *arg)
+{
+  uint mask = 1 << ((int)arg % ncpu);
+
+  if (setaffinity(0, mask) != 0 || getaffinity(0) != mask)
+  {
+    printf(1, "Thread %d: setaffinity failed\n", (int)arg);
+    strays[(int)arg]++;
+  }
+  strays[(int)arg] += stray(mask);
+  thread_exit(arg);
+  return 0;
+}
+
+// Threads inherit the mask of their creator.
+void *inherited(void *arg)
+{
+  strays[(int)arg] = stray(1);
+  thread_exit(arg);
+  return 0;
+}
+
+// Run NUM_THREAD threads and return their total stray count.
+int run(void *(*entry)(void *))
+{
+  void *retval;
+  int i, n;
+
+  memset(strays, 0, sizeof(strays));
+  for (i = 0; i < NUM_THREAD; i++)
+    if (thread_create(&thread[i], entry, (void *)i) != 0)
+    {
+      printf(1, "thread_create failed\n");
+      exit();
+    }
+  n = 0;
+  for (i = 0; i < NUM_THREAD; i++)
+  {
+    thread_join(thread[i], &retval);
+    n += strays[i];
+  }
+  return n;
+}
+
+int main(int argc, char *argv[])
+{
+  uint all;
+  int n, failed;
+
+  all = getaffinity(0);
+  for (ncpu = 0; (all >> ncpu) & 1; ncpu++)
+    ;
+  printf(1, "affinity test start, %d cpus\n", ncpu);
+  failed = 0;
+
+  if (setaffinity(0, 0) == 0 || getaffinity(999999) != -1)
+  {
+    printf(1, "bad arguments accepted\n");
+    failed = 1;
+  }
+
+  n = run(pinned);
+  printf(1, "pinned threads: %d checks on other cpus\n", n);
+  failed |= n != 0;
+
+  if (setaffinity(getpid(), 1) != 0 || getcpu() != 0)
+  {
+    printf(1, "pinning the process failed\n");
+    failed = 1;
+  }
+  n = run(inherited);
+  printf(1, "inherited mask: %d checks on other cpus\n", n);
+  failed |= n != 0;
+  setaffinity(getpid(), all);
+
+  if (failed)
+    printf(1, "affinity test failed\n");
+  else
+    printf(1, "affinity test passed\n");
+  exit();
+}
@@ -0,0 +1,96 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define HEAP_PAGES 1024
+#define PGSIZE 4096
+#define NUM_FORK 100
+
+// What fork() costs with a large heap: pages it takes, and time
+// for fork+exit and fork+exec, where copying the heap is wasted.
+
+char *heap;
+
+void failed()
+{
+  printf(1, "Test failed!\n");
+  exit();
+}
+
+// Ticks for NUM_FORK forks whose child exits, or execs itself.
+int forks(char *self, int doexec)
+{
+  char *argv[] = {self, "child", 0};
+  int i, pid, start;
+
+  start = uptime();
+  for (i = 0; i < NUM_FORK; i++)
+  {
+    pid = fork();
+    if (pid < 0)
+      failed();
+    if (pid == 0)
+    {
+      if (doexec)
+        exec(self, argv);
+      exit();
+    }
+    wait();
+  }
+  return uptime() - start;
+}
+
+int main(int argc, char *argv[])
+{
+  int i, before, used, fd[2];
+
+  if (argc > 1)
+    exit();
+
+  printf(1, "cow bench start\n");
+  if ((heap = sbrk(HEAP_PAGES * PGSIZE)) == (char *)-1)
+    failed();
+  for (i = 0; i < HEAP_PAGES; i++)
+    heap[i * PGSIZE] = 'p';
+
+  printf(1, "Test 1: Footprint\n");
+  if (pipe(fd) < 0)
+    failed();
+  before = freemem();
+  if (fork() == 0)
+  {
+    // Written by the kernel through a shared page.
+    if (read(fd[0], heap, 1) != 1 || heap[0] != 'c')
+      failed();
+    for (i = 1; i < HEAP_PAGES; i++)
+    {
+      if (heap[i * PGSIZE] != 'p')
+        failed();
+      heap[i * PGSIZE] = 'c';
+    }
+    exit();
+  }
+  used = before - freemem();
+  printf(1, "fork with a %d page heap took %d pages\n", HEAP_PAGES, used);
+  if (used >= HEAP_PAGES)
+    failed();
+  write(fd[1], "c", 1);
+  wait();
+  for (i = 0; i < HEAP_PAGES; i++)
+    if (heap[i * PGSIZE] != 'p')
+    {
+      printf(1, "page %d changed under the parent\n", i);
+      failed();
+    }
+  close(fd[0]);
+  close(fd[1]);
+  printf(1, "Test 1 passed\n\n");
+
+  printf(1, "Test 2: Fork time\n");
+  printf(1, "%d x fork+exit: %d ticks\n", NUM_FORK, forks(argv[0], 0));
+  printf(1, "%d x fork+exec: %d ticks\n", NUM_FORK, forks(argv[0], 1));
+  printf(1, "Test 2 passed\n\n");
+
+  printf(1, "cow bench finished\n");
+  exit();
+}
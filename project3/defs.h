@@ -1,15 +1,22 @@
 struct buf;
 struct context;
+struct fdtable;
 struct file;
 struct inode;
 struct pipe;
 struct proc;
 struct rtcdate;
+struct cpustat;
+struct mlfqconf;
+struct pstat;
+struct slabstat;
 struct spinlock;
 struct sleeplock;
+struct timer;
 struct stat;
 struct superblock;
 struct thread_t;
+struct vmspace;
 
 // bio.c
 void            binit(void);
@@ -34,6 +41,11 @@ void            fileinit(void);
 int             fileread(struct file*, char*, int n);
 int             filestat(struct file*, struct stat*);
 int             filewrite(struct file*, char*, int n);
+struct fdtable* fdtalloc(void);
+struct fdtable* fdtcopy(struct fdtable*);
+void            fdtdup(struct fdtable*, int);
+void            fdtdrop(struct fdtable*);
+void            fdtclose(struct fdtable*);
 
 // fs.c
 void            readsb(int dev, struct superblock *sb);
@@ -69,6 +81,10 @@ char*           kalloc(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+void            kcachestat(int, struct cpustat*);
+void            kdup(char*);
+int             krefcnt(char*);
+int             kfreepages(void);
 
 // kbd.c
 void            kbdintr(void);
@@ -78,6 +94,8 @@ void            cmostime(struct rtcdate *r);
 int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
+void            lapicipi(uchar, int);
+void            lapicspin(uint);
 void            lapicinit(void);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
@@ -120,19 +138,40 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
+void            wakeupone(void*);
+int             futexwait(uint, int);
+int             futexwake(uint, int);
 void            yield(void);
+int             needresched(void);
 int 		    setpriority(int pid, int pty);
 int		        getlev(void); 
+int             setaffinity(int, uint);
+int             getaffinity(int);
+int             getcpustat(struct cpustat*, int);
+int             getmlfq(struct mlfqconf*);
+int             setmlfq(struct mlfqconf*);
+int             settickets(int);
+int             getpinfo(struct pstat*, int);
 //proc.c - pthread
 int             thread_create(thread_t *thread, void*(*start_routine)(void *), void *arg);
 void            thread_exit(void *retval);
+int             thread_create_many(thread_t *thread, int n, void*(*start_routine)(void *), void **arg);
 int             thread_join(thread_t thread, void **retval);
-void            killAll(struct proc * curproc, int selfKill);
+int             thread_join_any(void **retval);
+int             thread_detach(thread_t thread);
+int             killAll(struct proc * curproc, int selfKill);
+void            threadquit(void);
 struct proc*    getMainThread(struct proc * curproc);
 
 // swtch.S
 void            swtch(struct context**, struct context*);
 
+// slab.c
+void            kminit(void);
+void*           kmalloc(uint);
+void            kmfree(void*);
+int             getslabstat(struct slabstat*, int);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
@@ -166,11 +205,16 @@ int             fetchstr(uint, char**);
 void            syscall(void);
 
 // timer.c
-void            timerinit(void);
+void            timeradd(struct timer*, uint);
+void            timerdel(struct timer*);
+void            timertick(void);
+int             sleepuntil(uint);
 
 // trap.c
 void            idtinit(void);
 extern uint     ticks;
+extern volatile uint boostepoch;
+extern volatile uint boostperiod;
 void            tvinit(void);
 extern struct spinlock tickslock;
 
@@ -189,10 +233,16 @@ int             deallocuvm(pde_t*, uint, uint);
 void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
-pde_t*          copyuvm(pde_t*, uint);
+pde_t*          copyuvm(pde_t*, uint, int);
+int             cowfault(pde_t*, uint);
+int             cowbreak(pde_t*, uint);
+int             lazyfault(struct vmspace*, uint);
+int             uvmtouch(struct vmspace*, uint, uint);
+uint            uvmresident(pde_t*, uint);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
+int             tlsinit(pde_t*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
 
 //prac_syscall.c
@@ -11,11 +11,12 @@ int
 exec(char *path, char **argv)
 {
   char *s, *last;
-  int i, off;
+  int i, off, nseg;
   uint argc, sz, sp, ustack[3+MAXARG+1];
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *exe, *oldip;
   struct proghdr ph;
+  struct vmseg seg[NVMSEG];
   pde_t *pgdir, *oldpgdir;
   struct proc *curproc = myproc();
 
@@ -30,6 +31,7 @@ exec(char *path, char **argv)
   }
   ilock(ip);
   pgdir = 0;
+  exe = 0;
 
   // Check ELF header
   if(readi(ip, (char*)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -40,8 +42,10 @@ exec(char *path, char **argv)
   if((pgdir = setupkvm()) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Record the program segments; lazyfault() reads each page
+  // in on first touch. Any beyond NVMSEG are loaded now.
   sz = 0;
+  nseg = 0;
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -49,17 +53,30 @@ exec(char *path, char **argv)
       continue;
     if(ph.memsz < ph.filesz)
       goto bad;
-    if(ph.vaddr + ph.memsz < ph.vaddr)
-      goto bad;
-    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+    if(ph.vaddr + ph.memsz < ph.vaddr || ph.vaddr + ph.memsz >= KERNBASE)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
-      goto bad;
+    if(nseg < NVMSEG){
+      seg[nseg].va = ph.vaddr;
+      seg[nseg].memsz = ph.memsz;
+      seg[nseg].off = ph.off;
+      seg[nseg].filesz = ph.filesz;
+      nseg++;
+    } else {
+      if(allocuvm(pgdir, ph.vaddr, ph.vaddr + ph.memsz) == 0)
+        goto bad;
+      if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
+        goto bad;
+    }
+    if(ph.vaddr + ph.memsz > sz)
+      sz = ph.vaddr + ph.memsz;
   }
-  iunlockput(ip);
+  // Keep the reference for lazyfault(); the process takes it
+  // over at the commit.
+  iunlock(ip);
   end_op();
+  exe = ip;
   ip = 0;
 
   // Allocate two pages at the next page boundary.
@@ -68,7 +85,9 @@ exec(char *path, char **argv)
   if((sz = allocuvm(pgdir, sz, sz + 2*PGSIZE)) == 0)
     goto bad;
   clearpteu(pgdir, (char*)(sz - 2*PGSIZE));
-  sp = sz;
+  sp = sz - TLSSIZE;
+  if(tlsinit(pgdir, sp) < 0)
+    goto bad;
 
   // Push argument strings, prepare rest of stack in ustack.
   for(argc = 0; argv[argc]; argc++) {
@@ -96,14 +115,32 @@ exec(char *path, char **argv)
   safestrcpy(curproc->name, last, sizeof(curproc->name));
 
   // Commit to the user image.
-  oldpgdir = curproc->pgdir;
-  curproc->pgdir = pgdir;
-  curproc->sz = sz;
+  // Other threads go first so none is left on the old page table.
+  // If one of them is already tearing the process down, back out;
+  // the syscall return then stops this thread.
+  if(killAll(curproc, 1) < 0)
+    goto bad;
+  oldpgdir = curproc->vm->pgdir;
+  oldip = curproc->vm->ip;
+  curproc->vm->pgdir = pgdir;
+  curproc->vm->sz = sz;
+  curproc->vm->ip = exe;
+  memmove(curproc->vm->seg, seg, sizeof(seg));
+  curproc->vm->nseg = nseg;
+  curproc->vm->main = curproc;
+  curproc->vm->nfreestack = 0;
+  curproc->vm->njoinable = 0;
+  curproc->detached = 0;
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
+  curproc->tls = sz - TLSSIZE;
   switchuvm(curproc);
   freevm(oldpgdir);
-  killAll(curproc, 1);
+  if(oldip){
+    begin_op();
+    iput(oldip);
+    end_op();
+  }
 
   return 0;
 
@@ -115,5 +152,10 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(exe){
+    begin_op();
+    iput(exe);
+    end_op();
+  }
   return -1;
 }
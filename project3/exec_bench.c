@@ -0,0 +1,89 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "pstat.h"
+#include "fcntl.h"
+
+#define NUM_EXEC 50
+
+// Start-up cost of exec() on a large program: usertests, which
+// quits at once while usertests.ran exists, against a small one.
+// Also shows how little of this program itself was read in.
+
+struct pstat ps[NPROC];
+
+void failed()
+{
+  printf(1, "Test failed!\n");
+  exit();
+}
+
+// Ticks for NUM_EXEC fork+exec+exit of path, output discarded.
+int execs(char *path)
+{
+  char *argv[] = {path, 0};
+  int i, pid, start;
+
+  start = uptime();
+  for (i = 0; i < NUM_EXEC; i++)
+  {
+    pid = fork();
+    if (pid < 0)
+      failed();
+    if (pid == 0)
+    {
+      close(1);
+      exec(path, argv);
+      printf(2, "exec %s failed\n", path);
+      exit();
+    }
+    wait();
+  }
+  return uptime() - start;
+}
+
+int main(int argc, char *argv[])
+{
+  struct stat st;
+  int i, n, fd, made;
+
+  printf(1, "exec bench start\n");
+
+  printf(1, "Test 1: Pages read in\n");
+  n = getpinfo(ps, NPROC);
+  for (i = 0; i < n; i++)
+    if (ps[i].pid == getpid() && ps[i].tid == -1)
+      break;
+  if (i == n || stat(argv[0], &st) < 0)
+    failed();
+  printf(1, "%s: %d bytes, %d pages read in, %d resident\n",
+         argv[0], st.size, ps[i].nload, ps[i].resident);
+  if (ps[i].nload > ps[i].resident)
+    failed();
+  printf(1, "Test 1 passed\n\n");
+
+  printf(1, "Test 2: Exec time\n");
+  if (stat("usertests", &st) < 0)
+    failed();
+  made = 0;
+  if ((fd = open("usertests.ran", 0)) < 0)
+  {
+    if ((fd = open("usertests.ran", O_CREATE)) < 0)
+      failed();
+    made = 1;
+  }
+  close(fd);
+  printf(1, "%d x usertests (%d bytes): %d ticks\n",
+         NUM_EXEC, st.size, execs("usertests"));
+  if (made)
+    unlink("usertests.ran");
+  if (stat("echo", &st) < 0)
+    failed();
+  printf(1, "%d x echo (%d bytes): %d ticks\n",
+         NUM_EXEC, st.size, execs("echo"));
+  printf(1, "Test 2 passed\n\n");
+
+  printf(1, "exec bench finished\n");
+  exit();
+}
@@ -0,0 +1,127 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NUM_CYCLE 1000
+#define NUM_OPEN 10
+
+thread_t t;
+int pfd[2];
+
+void failed()
+{
+  printf(1, "Test failed!\n");
+  exit();
+}
+
+// Open a pipe for the main thread to use.
+void *opener(void *arg)
+{
+  if (pipe(pfd) < 0)
+    failed();
+  thread_exit(0);
+  return 0;
+}
+
+// Try to read an fd the main thread closed.
+void *reader(void *arg)
+{
+  char c;
+
+  thread_exit((void *)read(pfd[0], &c, 1));
+  return 0;
+}
+
+// Block reading a pipe until the main thread writes to it.
+void *blocked(void *arg)
+{
+  char c;
+
+  if (read(pfd[0], &c, 1) != 1 || c != 'z')
+    thread_exit((void *)-1);
+  thread_exit(0);
+  return 0;
+}
+
+void *nop(void *arg)
+{
+  thread_exit(0);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  void *retval;
+  char c;
+  int i, fd[NUM_OPEN], start;
+
+  printf(1, "Test 1: Descriptors opened by a thread\n");
+  if (thread_create(&t, opener, 0) != 0)
+    failed();
+  thread_join(t, &retval);
+  if (write(pfd[1], "x", 1) != 1 || read(pfd[0], &c, 1) != 1 || c != 'x')
+    failed();
+  printf(1, "Test 1 passed\n\n");
+
+  printf(1, "Test 2: Descriptors closed by another thread\n");
+  close(pfd[0]);
+  if (thread_create(&t, reader, 0) != 0)
+    failed();
+  thread_join(t, &retval);
+  if ((int)retval != -1)
+    failed();
+  printf(1, "Test 2 passed\n\n");
+
+  printf(1, "Test 3: fork copies the table\n");
+  if (pipe(fd) < 0)
+    failed();
+  if (fork() == 0)
+  {
+    close(fd[1]);
+    exit();
+  }
+  wait();
+  if (write(fd[1], "y", 1) != 1 || read(fd[0], &c, 1) != 1 || c != 'y')
+    failed();
+  close(fd[0]);
+  close(fd[1]);
+  close(pfd[1]);
+  printf(1, "Test 3 passed\n\n");
+
+  printf(1, "Test 4: Thread churn with open files\n");
+  for (i = 0; i < NUM_OPEN; i++)
+    if ((fd[i] = open("README", 0)) < 0)
+      failed();
+  start = uptime();
+  for (i = 0; i < NUM_CYCLE; i++)
+  {
+    if (thread_create(&t, nop, 0) != 0)
+      failed();
+    thread_join(t, &retval);
+  }
+  printf(1, "%d create/join with %d files open: %d ticks\n",
+         NUM_CYCLE, NUM_OPEN, uptime() - start);
+  for (i = 0; i < NUM_OPEN; i++)
+    close(fd[i]);
+  printf(1, "Test 4 passed\n\n");
+
+  printf(1, "Test 5: Close while another thread reads\n");
+  if (pipe(pfd) < 0)
+    failed();
+  if (thread_create(&t, blocked, 0) != 0)
+    failed();
+  sleep(10);
+  if (close(pfd[0]) != 0 || read(pfd[0], &c, 1) != -1)
+    failed();
+  // The blocked read still holds the file, so the pipe stays open.
+  if (write(pfd[1], "z", 1) != 1)
+    failed();
+  thread_join(t, &retval);
+  if ((int)retval != 0)
+    failed();
+  close(pfd[1]);
+  printf(1, "Test 5 passed\n\n");
+
+  printf(1, "All tests passed!\n");
+  exit();
+}
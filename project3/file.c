@@ -11,9 +11,14 @@
 #include "file.h"
 
 struct devsw devsw[NDEV];
+
+// Files and descriptor tables come from kmalloc(). ftable.lock
+// guards the ref of every file, and caps open files at NFILE.
+// Threads share their process's descriptor table, so creating
+// and ending them only moves its ref and never touches ftable.
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  int nfile;                   // files allocated
 } ftable;
 
 void
@@ -29,15 +34,21 @@ filealloc(void)
   struct file *f;
 
   acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
+  if(ftable.nfile == NFILE){
+    release(&ftable.lock);
+    return 0;
   }
+  ftable.nfile++;
   release(&ftable.lock);
-  return 0;
+  if((f = kmalloc(sizeof(*f))) == 0){
+    acquire(&ftable.lock);
+    ftable.nfile--;
+    release(&ftable.lock);
+    return 0;
+  }
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -66,9 +77,9 @@ fileclose(struct file *f)
     return;
   }
   ff = *f;
-  f->ref = 0;
-  f->type = FD_NONE;
+  ftable.nfile--;
   release(&ftable.lock);
+  kmfree(f);
 
   if(ff.type == FD_PIPE)
     pipeclose(ff.pipe, ff.writable);
@@ -155,3 +166,86 @@ filewrite(struct file *f, char *addr, int n)
   panic("filewrite");
 }
 
+
+// Allocate an empty descriptor table.
+struct fdtable*
+fdtalloc(void)
+{
+  struct fdtable *t;
+
+  if((t = kmalloc(sizeof(*t))) == 0)
+    return 0;
+  initlock(&t->lock, "fdtable");
+  t->ref = 1;
+  memset(t->ofile, 0, sizeof(t->ofile));
+  return t;
+}
+
+// A new table with the same open files, for fork().
+struct fdtable*
+fdtcopy(struct fdtable *old)
+{
+  struct fdtable *t;
+  struct file *f;
+  int fd;
+
+  if((t = fdtalloc()) == 0)
+    return 0;
+  for(fd = 0; fd < NOFILE; fd++){
+    acquire(&old->lock);
+    f = old->ofile[fd];
+    if(f)
+      filedup(f);
+    release(&old->lock);
+    t->ofile[fd] = f;
+  }
+  return t;
+}
+
+// n more threads use t.
+void
+fdtdup(struct fdtable *t, int n)
+{
+  acquire(&t->lock);
+  if(t->ref < 1)
+    panic("fdtdup");
+  t->ref += n;
+  release(&t->lock);
+}
+
+// Drop a reference that cannot be the last, for callers that
+// must not sleep in fileclose().
+void
+fdtdrop(struct fdtable *t)
+{
+  acquire(&t->lock);
+  if(t->ref < 2)
+    panic("fdtdrop");
+  t->ref--;
+  release(&t->lock);
+}
+
+// Drop a reference to t; the last one closes the files.
+void
+fdtclose(struct fdtable *t)
+{
+  struct file *ofile[NOFILE];
+  int fd;
+
+  acquire(&t->lock);
+  if(t->ref < 1)
+    panic("fdtclose");
+  if(t->ref > 1){
+    t->ref--;
+    release(&t->lock);
+    return;
+  }
+  // Free the table first, and close the files after, since
+  // fileclose() may sleep.
+  memmove(ofile, t->ofile, sizeof(ofile));
+  release(&t->lock);
+  kmfree(t);
+  for(fd = 0; fd < NOFILE; fd++)
+    if(ofile[fd])
+      fileclose(ofile[fd]);
+}
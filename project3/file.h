@@ -8,6 +8,13 @@ struct file {
   uint off;
 };
 
+// Open files of a process, shared by its threads.
+struct fdtable {
+  struct spinlock lock; // protects ofile and ref
+  int ref;              // threads using the table
+  struct file *ofile[NOFILE];
+};
+
 
 // in-memory copy of an inode
 struct inode {
@@ -0,0 +1,190 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NUM_THREAD 4
+#define NUM_INC 20000
+#define NUM_ITEM 1000
+#define NUM_ROUND 100
+
+thread_t thread[NUM_THREAD];
+
+volatile int spin;
+mutex_t lock;
+cond_t nonempty, nonfull;
+barrier_t barrier;
+
+volatile int counter;
+volatile int slot, full;
+int consumed;
+volatile int arrived[NUM_ROUND];
+
+void failed()
+{
+  printf(1, "Test failed!\n");
+  exit();
+}
+
+void spin_lock()
+{
+  int old;
+
+  for (;;) {
+    old = 1;
+    asm volatile("lock; xchgl %0, %1" : "+m" (spin), "+r" (old));
+    if (old == 0)
+      return;
+  }
+}
+
+void spin_unlock()
+{
+  asm volatile("movl $0, %0" : "+m" (spin) : : "memory");
+}
+
+// A short critical section, so lock hand-off dominates.
+void *inc_spin(void *arg)
+{
+  int i;
+
+  for (i = 0; i < NUM_INC; i++) {
+    spin_lock();
+    counter++;
+    spin_unlock();
+  }
+  thread_exit(arg);
+  return 0;
+}
+
+void *inc_mutex(void *arg)
+{
+  int i;
+
+  for (i = 0; i < NUM_INC; i++) {
+    mutex_lock(&lock);
+    counter++;
+    mutex_unlock(&lock);
+  }
+  thread_exit(arg);
+  return 0;
+}
+
+void *producer(void *arg)
+{
+  int i;
+
+  for (i = 1; i <= NUM_ITEM; i++) {
+    mutex_lock(&lock);
+    while (full)
+      cond_wait(&nonfull, &lock);
+    slot = i;
+    full = 1;
+    cond_signal(&nonempty);
+    mutex_unlock(&lock);
+  }
+  thread_exit(arg);
+  return 0;
+}
+
+void *consumer(void *arg)
+{
+  int i;
+
+  for (i = 0; i < NUM_ITEM; i++) {
+    mutex_lock(&lock);
+    while (!full)
+      cond_wait(&nonempty, &lock);
+    consumed += slot;
+    full = 0;
+    cond_signal(&nonfull);
+    mutex_unlock(&lock);
+  }
+  thread_exit(arg);
+  return 0;
+}
+
+void *rounds(void *arg)
+{
+  int r;
+
+  for (r = 0; r < NUM_ROUND; r++) {
+    mutex_lock(&lock);
+    arrived[r]++;
+    mutex_unlock(&lock);
+    barrier_wait(&barrier);
+    if (arrived[r] != NUM_THREAD) {
+      printf(1, "Round %d: %d threads arrived\n", r, arrived[r]);
+      failed();
+    }
+  }
+  thread_exit(arg);
+  return 0;
+}
+
+void run(int n, void *(*entry)(void *))
+{
+  int i;
+  void *retval;
+
+  for (i = 0; i < n; i++) {
+    if (thread_create(&thread[i], entry, (void *)i) != 0) {
+      printf(1, "Error creating thread %d\n", i);
+      failed();
+    }
+  }
+  for (i = 0; i < n; i++) {
+    if (thread_join(thread[i], &retval) != 0) {
+      printf(1, "Error joining thread %d\n", i);
+      failed();
+    }
+  }
+}
+
+// Time NUM_THREAD threads bumping one counter under a lock.
+int contend(void *(*entry)(void *))
+{
+  int start;
+
+  counter = 0;
+  start = uptime();
+  run(NUM_THREAD, entry);
+  if (counter != NUM_THREAD * NUM_INC) {
+    printf(1, "Counter is %d, expected %d\n", counter, NUM_THREAD * NUM_INC);
+    failed();
+  }
+  return uptime() - start;
+}
+
+int main(int argc, char *argv[])
+{
+  thread_t p, c;
+  void *retval;
+
+  mutex_init(&lock);
+  cond_init(&nonempty);
+  cond_init(&nonfull);
+
+  printf(1, "Test 1: Contention\n");
+  printf(1, "spinlock: %d ticks\n", contend(inc_spin));
+  printf(1, "mutex: %d ticks\n", contend(inc_mutex));
+  printf(1, "Test 1 passed\n\n");
+
+  printf(1, "Test 2: Condition variables\n");
+  if (thread_create(&p, producer, 0) != 0 || thread_create(&c, consumer, 0) != 0)
+    failed();
+  thread_join(p, &retval);
+  thread_join(c, &retval);
+  if (consumed != NUM_ITEM * (NUM_ITEM + 1) / 2) {
+    printf(1, "Consumed %d, expected %d\n", consumed, NUM_ITEM * (NUM_ITEM + 1) / 2);
+    failed();
+  }
+  printf(1, "Test 2 passed\n\n");
+
+  printf(1, "Test 3: Barrier\n");
+  barrier_init(&barrier, NUM_THREAD);
+  run(NUM_THREAD, rounds);
+  printf(1, "Test 3 passed\n\n");
+
+  printf(1, "All tests passed!\n");
+  exit();
+}
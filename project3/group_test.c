@@ -0,0 +1,157 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "mlfq.h"
+
+#define NUM_THREAD 8
+#define RUN_TICKS 300
+#define TOLERANCE 15 // percent
+
+// A process with one spinning thread competes with a process
+// with NUM_THREAD spinning threads, once with per-thread and
+// once with per-process MLFQ fairness. Per process, the
+// one-thread process should get about half of the work done.
+// Needs a kernel built with SCHED_POLICY=MLFQ_SCHED.
+
+thread_t thread[NUM_THREAD];
+int count[NUM_THREAD];
+int end;
+
+// Spin until end, counting iterations.
+int work(void)
+{
+  volatile int i;
+  int n;
+
+  n = 0;
+  while (uptime() < end)
+  {
+    for (i = 0; i < 1000; i++)
+      ;
+    n++;
+  }
+  return n;
+}
+
+void *spinner(void *arg)
+{
+  count[(int)arg] = work();
+  thread_exit(0);
+  return 0;
+}
+
+// Run nthread spinners from start until start + RUN_TICKS and
+// report {nthread, total count} to the parent; count -1 on failure.
+void child(int fd, int nthread, int start)
+{
+  void *retval;
+  int i, msg[2];
+
+  msg[0] = nthread;
+  msg[1] = -1;
+  end = start + RUN_TICKS;
+  while (uptime() < start)
+    ;
+  if (nthread == 1)
+  {
+    msg[1] = work();
+  }
+  else
+  {
+    for (i = 0; i < nthread; i++)
+    {
+      if (thread_create(&thread[i], spinner, (void *)i) != 0)
+      {
+        printf(1, "thread_create failed\n");
+        write(fd, msg, sizeof(msg));
+        exit();
+      }
+    }
+    msg[1] = 0;
+    for (i = 0; i < nthread; i++)
+    {
+      thread_join(thread[i], &retval);
+      msg[1] += count[i];
+    }
+  }
+  write(fd, msg, sizeof(msg));
+  exit();
+}
+
+// Percent of the work the one-thread process did, -1 on failure.
+int compete(int group)
+{
+  struct mlfqconf mc;
+  int fd[2], msg[2], one, many, i, start;
+
+  if (getmlfq(&mc) < 0)
+  {
+    printf(1, "kernel not built with MLFQ_SCHED\n");
+    return -1;
+  }
+  mc.group = group;
+  if (setmlfq(&mc) < 0)
+  {
+    printf(1, "setmlfq failed\n");
+    return -1;
+  }
+  if (pipe(fd) < 0)
+  {
+    printf(1, "pipe failed\n");
+    return -1;
+  }
+  start = uptime() + 20;
+  if (fork() == 0)
+    child(fd[1], 1, start);
+  if (fork() == 0)
+    child(fd[1], NUM_THREAD, start);
+  one = many = -1;
+  for (i = 0; i < 2; i++)
+  {
+    if (read(fd[0], msg, sizeof(msg)) != sizeof(msg))
+      break;
+    if (msg[0] == 1)
+      one = msg[1];
+    else
+      many = msg[1];
+  }
+  wait();
+  wait();
+  close(fd[0]);
+  close(fd[1]);
+  if (one < 0 || many < 0 || one + many == 0)
+    return -1;
+  printf(1, "%s: 1 thread %d, %d threads %d, share %d%%\n",
+         group ? "per-process" : "per-thread",
+         one, NUM_THREAD, many, one * 100 / (one + many));
+  return one * 100 / (one + many);
+}
+
+int main(int argc, char *argv[])
+{
+  struct mlfqconf mc;
+  int share;
+
+  printf(1, "group test start\n");
+  if (getmlfq(&mc) < 0)
+  {
+    printf(1, "kernel not built with MLFQ_SCHED\n");
+    exit();
+  }
+  if (compete(0) < 0 || (share = compete(1)) < 0)
+  {
+    printf(1, "group test failed\n");
+    setmlfq(&mc);
+    exit();
+  }
+  setmlfq(&mc);
+  if (share < 50 - TOLERANCE)
+  {
+    printf(1, "one-thread process got %d%% per process\n", share);
+    printf(1, "group test failed\n");
+    exit();
+  }
+  printf(1, "group test finished\n");
+  exit();
+}
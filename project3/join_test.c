@@ -0,0 +1,154 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NUM_THREAD 8
+#define NUM_CYCLE 1000
+#define NUM_INFLIGHT 16
+
+thread_t thread[NUM_THREAD];
+int joined[NUM_THREAD];
+mutex_t lock;
+volatile int done;
+
+void failed()
+{
+  printf(1, "Test failed!\n");
+  exit();
+}
+
+// Threads with a higher number take longer.
+void *sleeper(void *arg)
+{
+  sleep((NUM_THREAD - (int)arg) * 2);
+  thread_exit(arg);
+  return 0;
+}
+
+void *worker(void *arg)
+{
+  mutex_lock(&lock);
+  done++;
+  mutex_unlock(&lock);
+  thread_exit(arg);
+  return 0;
+}
+
+void create(thread_t *t, void *(*entry)(void *), void *arg)
+{
+  if (thread_create(t, entry, arg) != 0)
+  {
+    printf(1, "Error creating thread\n");
+    failed();
+  }
+}
+
+// Each thread comes back once, with its own return value.
+void joinany(void)
+{
+  void *retval;
+  int i, j, tid;
+
+  for (i = 0; i < NUM_THREAD; i++)
+    create(&thread[i], sleeper, (void *)i);
+  for (i = 0; i < NUM_THREAD; i++)
+  {
+    if ((tid = thread_join_any(&retval)) < 0)
+      failed();
+    for (j = 0; j < NUM_THREAD && thread[j] != tid; j++)
+      ;
+    if (j == NUM_THREAD || joined[j] || (int)retval != j)
+    {
+      printf(1, "Bad join: tid %d, retval %d\n", tid, (int)retval);
+      failed();
+    }
+    joined[j] = 1;
+  }
+  if (thread_join_any(&retval) != -1)
+  {
+    printf(1, "thread_join_any with no threads left succeeded\n");
+    failed();
+  }
+}
+
+// Far more detached threads than proc slots: only works if
+// the kernel frees them.
+void detach(void)
+{
+  thread_t t;
+  void *retval;
+  int i;
+
+  done = 0;
+  for (i = 0; i < NUM_CYCLE; i++)
+  {
+    while (i - done >= NUM_INFLIGHT)
+      yield();
+    create(&t, worker, 0);
+    if (thread_detach(t) != 0)
+      failed();
+  }
+  while (done < NUM_CYCLE)
+    yield();
+  if (thread_join(t, &retval) != -1 || thread_detach(t) != -1)
+  {
+    printf(1, "Detached thread could be joined\n");
+    failed();
+  }
+
+  // Detaching one that already exited frees it at once.
+  create(&t, worker, 0);
+  sleep(10);
+  if (thread_detach(t) != 0 || thread_join(t, &retval) != -1)
+    failed();
+}
+
+// A pool of NUM_THREAD workers, replaced as they finish.
+int pool(int any)
+{
+  void *retval;
+  int i, n, start;
+
+  start = uptime();
+  for (i = 0; i < NUM_THREAD; i++)
+    create(&thread[i], worker, (void *)i);
+  for (n = NUM_THREAD; n < NUM_CYCLE; n++)
+  {
+    if (any)
+    {
+      if (thread_join_any(&retval) < 0)
+        failed();
+      i = (int)retval;
+    }
+    else
+    {
+      i = n % NUM_THREAD;
+      thread_join(thread[i], &retval);
+    }
+    create(&thread[i], worker, (void *)i);
+  }
+  for (i = 0; i < NUM_THREAD; i++)
+    thread_join_any(&retval);
+  return uptime() - start;
+}
+
+int main(int argc, char *argv[])
+{
+  mutex_init(&lock);
+
+  printf(1, "Test 1: thread_join_any\n");
+  joinany();
+  printf(1, "Test 1 passed\n\n");
+
+  printf(1, "Test 2: thread_detach\n");
+  detach();
+  printf(1, "Test 2 passed\n\n");
+
+  printf(1, "Test 3: Worker pool\n");
+  printf(1, "join in order: %d ticks\n", pool(0));
+  printf(1, "join any: %d ticks\n", pool(1));
+  printf(1, "Test 3 passed\n\n");
+
+  printf(1, "All tests passed!\n");
+  exit();
+}
@@ -8,6 +8,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "spinlock.h"
+#include "pstat.h"
 
 void freerange(void *vstart, void *vend);
 extern char end[]; // first address after kernel loaded from ELF file
@@ -17,21 +18,51 @@ struct run {
   struct run *next;
 };
 
+#define KBATCH   32   // pages moved between a CPU cache and the pool
+#define KCACHEMAX 64  // pages a CPU keeps before draining a batch
+
+// A page can be mapped by several page tables after a
+// copy-on-write fork; ref counts them, and kfree() only frees a
+// page when the last one lets go. Only shared pages take reflock:
+// nobody else can change the count of a page held once.
 struct {
   struct spinlock lock;
+  struct spinlock reflock;
   int use_lock;
   struct run *freelist;
+  uint nfree;                      // pages on freelist
+  ushort ref[PHYSTOP/PGSIZE];      // references to each page
 } kmem;
 
+// Free pages kept by each CPU, so most kalloc() and kfree()
+// calls take only an uncontended lock. The pool in kmem refills
+// and takes back a batch at a time. Lock order: a kcache lock,
+// then kmem.lock; never two kcache locks at once.
+struct kcache {
+  struct spinlock lock;
+  struct run *freelist;
+  uint n;                          // pages on freelist
+  uint nalloc;                     // pages handed out by kalloc()
+  uint nrefill;                    // batches taken from the pool
+  uint ndrain;                     // batches given back to the pool
+  uint nsteal;                     // pages taken from other CPUs
+} kcache[NCPU];
+
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
 // 2. main() calls kinit2() with the rest of the physical pages
 // after installing a full page table that maps them on all cores.
+// Until then every page goes through the pool in kmem.
 void
 kinit1(void *vstart, void *vend)
 {
+  int i;
+
   initlock(&kmem.lock, "kmem");
+  initlock(&kmem.reflock, "kref");
+  for(i = 0; i < NCPU; i++)
+    initlock(&kcache[i].lock, "kcache");
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -48,9 +79,84 @@ freerange(void *vstart, void *vend)
 {
   char *p;
   p = (char*)PGROUNDUP((uint)vstart);
-  for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)vend; p += PGSIZE){
+    kmem.ref[V2P(p)/PGSIZE] = 1;
     kfree(p);
+  }
+}
+
+// The cache of the CPU we are on. We may move to another CPU
+// right after; that only costs locality, as callers lock it.
+static struct kcache*
+mycache(void)
+{
+  struct kcache *c;
+
+  pushcli();
+  c = &kcache[cpuid()];
+  popcli();
+  return c;
+}
+
+// Move up to n pages from the pool to c. c->lock must be held.
+static void
+refill(struct kcache *c, int n)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  while(n-- > 0 && (r = kmem.freelist) != 0){
+    kmem.freelist = r->next;
+    kmem.nfree--;
+    r->next = c->freelist;
+    c->freelist = r;
+    c->n++;
+  }
+  release(&kmem.lock);
+  c->nrefill++;
+}
+
+// Give n pages of c back to the pool. c->lock must be held.
+static void
+drain(struct kcache *c, int n)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  while(n-- > 0 && (r = c->freelist) != 0){
+    c->freelist = r->next;
+    c->n--;
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+    kmem.nfree++;
+  }
+  release(&kmem.lock);
+  c->ndrain++;
+}
+
+// Take a page from another CPU's cache once ours and the pool
+// are both empty. The counts are read without locks; rechecked.
+static struct run*
+steal(struct kcache *self)
+{
+  struct kcache *c;
+  struct run *r;
+
+  for(c = kcache; c < &kcache[NCPU]; c++){
+    if(c == self || c->n == 0)
+      continue;
+    acquire(&c->lock);
+    if((r = c->freelist) != 0){
+      c->freelist = r->next;
+      c->n--;
+    }
+    release(&c->lock);
+    if(r)
+      return r;
+  }
+  return 0;
 }
+
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
@@ -60,20 +166,40 @@ void
 kfree(char *v)
 {
   struct run *r;
+  struct kcache *c;
+  ushort *ref;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  ref = &kmem.ref[V2P(v)/PGSIZE];
+  if(*ref < 1)
+    panic("kfree: ref");
+  if(*ref > 1){
+    acquire(&kmem.reflock);
+    if(--*ref > 0){
+      release(&kmem.reflock);
+      return;
+    }
+    release(&kmem.reflock);
+  }
+  *ref = 0;
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
-
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
   r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+  if(!kmem.use_lock){
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+    kmem.nfree++;
+    return;
+  }
+  c = mycache();
+  acquire(&c->lock);
+  r->next = c->freelist;
+  c->freelist = r;
+  if(++c->n > KCACHEMAX)
+    drain(c, KBATCH);
+  release(&c->lock);
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -83,14 +209,80 @@ char*
 kalloc(void)
 {
   struct run *r;
+  struct kcache *c;
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
-  r = kmem.freelist;
+  if(!kmem.use_lock){
+    if((r = kmem.freelist) != 0){
+      kmem.freelist = r->next;
+      kmem.nfree--;
+      kmem.ref[V2P(r)/PGSIZE] = 1;
+    }
+    return (char*)r;
+  }
+  c = mycache();
+  acquire(&c->lock);
+  if(c->freelist == 0)
+    refill(c, KBATCH);
+  if((r = c->freelist) != 0){
+    c->freelist = r->next;
+    c->n--;
+  }
+  c->nalloc++;
+  release(&c->lock);
+  if(r == 0 && (r = steal(c)) != 0){
+    acquire(&c->lock);
+    c->nsteal++;
+    release(&c->lock);
+  }
   if(r)
-    kmem.freelist = r->next;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+    kmem.ref[V2P(r)/PGSIZE] = 1;
   return (char*)r;
 }
 
+// Take another reference to the allocated page v.
+void
+kdup(char *v)
+{
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kdup");
+  acquire(&kmem.reflock);
+  if(kmem.ref[V2P(v)/PGSIZE] < 1)
+    panic("kdup: ref");
+  kmem.ref[V2P(v)/PGSIZE]++;
+  release(&kmem.reflock);
+}
+
+// How many page tables map page v.
+int
+krefcnt(char *v)
+{
+  return kmem.ref[V2P(v)/PGSIZE];
+}
+
+// Copy the counters of CPU i's page cache into cs.
+void
+kcachestat(int i, struct cpustat *cs)
+{
+  struct kcache *c = &kcache[i];
+
+  acquire(&c->lock);
+  cs->nalloc = c->nalloc;
+  cs->nrefill = c->nrefill;
+  cs->ndrain = c->ndrain;
+  cs->nsteal = c->nsteal;
+  cs->nfree = c->n;
+  release(&c->lock);
+}
+
+// Free pages left, in the pool and in every CPU's cache.
+// Read without locks, so only a snapshot.
+int
+kfreepages(void)
+{
+  int i, n;
+
+  n = kmem.nfree;
+  for(i = 0; i < NCPU; i++)
+    n += kcache[i].n;
+  return n;
+}
@@ -0,0 +1,91 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "pstat.h"
+
+#define NUM_FORK 200
+
+// Page allocator throughput: 1 to ncpu workers, each pinned to
+// its own CPU, fork and reap children that exit at once, and
+// make and close a pipe. Every round allocates and frees page
+// tables, kernel stacks and pipe buffers.
+
+struct cpustat before[NCPU], after[NCPU];
+
+void failed()
+{
+  printf(1, "Test failed!\n");
+  exit();
+}
+
+void worker(int cpu)
+{
+  int i, pid, fd[2];
+
+  if (setaffinity(0, 1 << cpu) < 0)
+    failed();
+  for (i = 0; i < NUM_FORK; i++)
+  {
+    if ((pid = fork()) < 0)
+      failed();
+    if (pid == 0)
+      exit();
+    if (pipe(fd) < 0)
+      failed();
+    close(fd[0]);
+    close(fd[1]);
+    wait();
+  }
+  exit();
+}
+
+// Run n workers at once and report ticks and allocator counters.
+void run(int n, int ncpu)
+{
+  int i, start, elapsed;
+  uint nalloc, nrefill, ndrain, nsteal;
+
+  getcpustat(before, NCPU);
+  start = uptime();
+  for (i = 0; i < n; i++)
+  {
+    int pid = fork();
+    if (pid < 0)
+      failed();
+    if (pid == 0)
+      worker(i);
+  }
+  for (i = 0; i < n; i++)
+    if (wait() < 0)
+      failed();
+  elapsed = uptime() - start;
+  getcpustat(after, NCPU);
+
+  nalloc = nrefill = ndrain = nsteal = 0;
+  for (i = 0; i < ncpu; i++)
+  {
+    nalloc += after[i].nalloc - before[i].nalloc;
+    nrefill += after[i].nrefill - before[i].nrefill;
+    ndrain += after[i].ndrain - before[i].ndrain;
+    nsteal += after[i].nsteal - before[i].nsteal;
+  }
+  if (elapsed == 0)
+    elapsed = 1;
+  printf(1, "%d cpus: %d forks in %d ticks, %d forks/100 ticks, "
+            "%d pages, refill %d drain %d steal %d\n",
+         n, n * NUM_FORK, elapsed, n * NUM_FORK * 100 / elapsed,
+         nalloc, nrefill, ndrain, nsteal);
+}
+
+int main(int argc, char *argv[])
+{
+  int n, ncpu;
+
+  printf(1, "kalloc bench start\n");
+  ncpu = getcpustat(before, NCPU);
+  for (n = 1; n <= ncpu; n++)
+    run(n, ncpu);
+  printf(1, "kalloc bench finished\n");
+  exit();
+}
@@ -0,0 +1,111 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "pstat.h"
+
+#define HEAP_PAGES 1024
+#define PGSIZE 4096
+#define STRIDE 8
+#define NUM_ROUND 200
+
+// What sbrk() costs now that heap pages are faulted in on first
+// touch: pages taken before and after touching, faults counted by
+// the kernel, and time for sbrk rounds that touch little.
+
+struct pstat ps[NPROC];
+
+void failed()
+{
+  printf(1, "Test failed!\n");
+  exit();
+}
+
+// The kernel's statistics for this process.
+struct pstat *self()
+{
+  int i, n, pid;
+
+  pid = getpid();
+  n = getpinfo(ps, NPROC);
+  for (i = 0; i < n; i++)
+    if (ps[i].pid == pid && ps[i].tid == -1)
+      return &ps[i];
+  failed();
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  char *heap;
+  struct pstat *p;
+  int i, before, used, start, fd[2];
+  uint nfault, resident;
+
+  printf(1, "lazy bench start\n");
+
+  printf(1, "Test 1: Footprint\n");
+  before = freemem();
+  p = self();
+  nfault = p->nfault - p->nload;
+  if ((heap = sbrk(HEAP_PAGES * PGSIZE)) == (char *)-1)
+    failed();
+  used = before - freemem();
+  printf(1, "sbrk of %d pages took %d pages\n", HEAP_PAGES, used);
+  if (used >= HEAP_PAGES / STRIDE)
+    failed();
+  for (i = 0; i < HEAP_PAGES; i += STRIDE)
+    if (heap[i * PGSIZE] != 0)
+      failed();
+  for (i = 0; i < HEAP_PAGES; i += STRIDE)
+    heap[i * PGSIZE] = 'l';
+  used = before - freemem();
+  p = self();
+  nfault = p->nfault - p->nload - nfault;
+  resident = p->resident;
+  printf(1, "touching %d pages took %d pages, %d faults, %d resident\n",
+         HEAP_PAGES / STRIDE, used, nfault, resident);
+  if (nfault != HEAP_PAGES / STRIDE || used > HEAP_PAGES / STRIDE + 4)
+    failed();
+  printf(1, "Test 1 passed\n\n");
+
+  printf(1, "Test 2: Kernel writes to untouched heap\n");
+  if (pipe(fd) < 0)
+    failed();
+  if (write(fd[1], "lazy", 4) != 4 || read(fd[0], heap + PGSIZE, 4) != 4 ||
+      heap[PGSIZE] != 'l' || heap[PGSIZE + 3] != 'y')
+    failed();
+  close(fd[0]);
+  close(fd[1]);
+  if (fork() == 0)
+  {
+    // The child faults in heap the parent never touched.
+    if (heap[2 * PGSIZE] != 0)
+      failed();
+    heap[2 * PGSIZE] = 'c';
+    exit();
+  }
+  wait();
+  if (heap[2 * PGSIZE] != 0 || heap[0] != 'l')
+    failed();
+  printf(1, "Test 2 passed\n\n");
+
+  printf(1, "Test 3: Sbrk time\n");
+  if (sbrk(-HEAP_PAGES * PGSIZE) == (char *)-1)
+    failed();
+  start = uptime();
+  for (i = 0; i < NUM_ROUND; i++)
+  {
+    if ((heap = sbrk(HEAP_PAGES * PGSIZE)) == (char *)-1)
+      failed();
+    heap[0] = 'l';
+    if (sbrk(-HEAP_PAGES * PGSIZE) == (char *)-1)
+      failed();
+  }
+  printf(1, "%d x sbrk of %d pages, one touched: %d ticks\n",
+         NUM_ROUND, HEAP_PAGES, uptime() - start);
+  printf(1, "Test 3 passed\n\n");
+
+  printf(1, "lazy bench finished\n");
+  exit();
+}
@@ -0,0 +1,137 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define MAX_THREAD 8
+#define NUM_OPS 20000
+#define NUM_SLOT 64
+#define NUM_FRAG 2000
+
+// malloc/free throughput with 1 to MAX_THREAD threads, each
+// churning its own working set of NUM_SLOT blocks, then a
+// report of where the heap's memory went.
+
+thread_t thread[MAX_THREAD];
+volatile int bad;
+
+uint rnd(uint *seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 16) & 0x7fff;
+}
+
+// Mostly small blocks, now and then a large one.
+uint blocksize(uint *seed)
+{
+  uint r = rnd(seed);
+
+  if (r % 64 == 0)
+    return 4096 + r % 4096;
+  return 8 + r % 1024;
+}
+
+void *churn(void *arg)
+{
+  char *slot[NUM_SLOT];
+  uint seed = (uint)arg + 1;
+  int i, s;
+
+  memset(slot, 0, sizeof(slot));
+  for (i = 0; i < NUM_OPS; i++)
+  {
+    s = rnd(&seed) % NUM_SLOT;
+    if (slot[s])
+    {
+      if (slot[s][0] != (char)s)
+        bad = 1;
+      free(slot[s]);
+      slot[s] = 0;
+    }
+    else if ((slot[s] = malloc(blocksize(&seed))) != 0)
+      slot[s][0] = s;
+    else
+      bad = 1;
+  }
+  for (s = 0; s < NUM_SLOT; s++)
+    free(slot[s]);
+  thread_exit(0);
+  return 0;
+}
+
+void report(char *when)
+{
+  struct mallinfo mi;
+
+  mallinfo(&mi);
+  printf(1, "%s: heap %d, in use %d, cached %d, free %d, largest free %d\n",
+         when, mi.heap, mi.inuse, mi.cached, mi.free, mi.largest);
+}
+
+void throughput(int n)
+{
+  void *retval;
+  int i, start, elapsed;
+
+  start = uptime();
+  for (i = 0; i < n; i++)
+  {
+    if (thread_create(&thread[i], churn, (void *)i) != 0)
+    {
+      printf(1, "thread_create failed\n");
+      exit();
+    }
+  }
+  for (i = 0; i < n; i++)
+    thread_join(thread[i], &retval);
+  elapsed = uptime() - start;
+  if (elapsed == 0)
+    elapsed = 1;
+  // ticks are 10ms
+  printf(1, "%d threads: %d ops in %d ticks, %d ops/sec\n",
+         n, n * NUM_OPS, elapsed, n * NUM_OPS * 100 / elapsed);
+}
+
+// Free every other block of a mixed batch, so the holes are
+// scattered through the heap.
+void fragment(void)
+{
+  char *p[NUM_FRAG];
+  uint seed = 7;
+  int i;
+
+  for (i = 0; i < NUM_FRAG; i++)
+    p[i] = malloc(blocksize(&seed));
+  report("allocated");
+  for (i = 0; i < NUM_FRAG; i += 2)
+    free(p[i]);
+  report("half freed");
+  for (i = 1; i < NUM_FRAG; i += 2)
+    free(p[i]);
+  report("all freed");
+}
+
+int main(int argc, char *argv[])
+{
+  struct mallinfo mi;
+  int n;
+
+  printf(1, "malloc bench start\n");
+  for (n = 1; n <= MAX_THREAD; n *= 2)
+    throughput(n);
+  if (bad)
+  {
+    printf(1, "a block was lost or overwritten\n");
+    exit();
+  }
+  report("after churn");
+  // Exited threads hand their caches back.
+  mallinfo(&mi);
+  if (mi.cached != 0)
+  {
+    printf(1, "exited threads left %d bytes cached\n", mi.cached);
+    exit();
+  }
+  fragment();
+  printf(1, "malloc bench finished\n");
+  exit();
+}
@@ -0,0 +1,8 @@
+// MLFQ tuning, read and set at run time by getmlfq()/setmlfq().
+struct mlfqconf {
+  int nlevel;            // Number of levels in use, 1..NLEVEL
+  int quantum[NLEVEL];   // Time quantum of each level, in ticks
+  int boost;             // Ticks between priority boosts, 0 for none
+  int group;             // 1: threads of a process share level, quantum
+                         // and CPU share; 0: each thread on its own
+};
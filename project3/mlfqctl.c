@@ -0,0 +1,118 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "mlfq.h"
+
+// Show or change the MLFQ tuning of the running kernel.
+//   mlfqctl                         print the current settings
+//   mlfqctl <profile>               apply a built-in profile
+//   mlfqctl set <boost> <q0> [q1..] levels with the given quanta
+//   mlfqctl group <0|1>             fairness per thread (0) or per
+//                                   process (1)
+
+struct profile {
+  char *name;
+  int nlevel;
+  int quantum[NLEVEL];
+  int boost;
+};
+
+struct profile profiles[] = {
+  // what the kernel starts with when built with MLFQ_K=5
+  { "classic", 5, { 2, 6, 10, 14, 18 }, 100 },
+  // many short levels, frequent boosts: favours interactive jobs
+  { "interactive", 8, { 1, 2, 2, 4, 4, 8, 8, 16 }, 50 },
+  // few long levels, rare boosts: fewer switches for batch jobs
+  { "batch", 3, { 10, 20, 40 }, 500 },
+};
+
+void
+show(void)
+{
+  struct mlfqconf mc;
+  int lv;
+
+  if(getmlfq(&mc) < 0){
+    printf(2, "mlfqctl: kernel not built with MLFQ_SCHED\n");
+    exit();
+  }
+  printf(1, "levels %d, boost every %d ticks, %s fairness\n",
+         mc.nlevel, mc.boost, mc.group ? "per-process" : "per-thread");
+  for(lv = 0; lv < mc.nlevel; lv++)
+    printf(1, "L%d: quantum %d\n", lv, mc.quantum[lv]);
+}
+
+// Start from the current settings so a change keeps the rest.
+void
+current(struct mlfqconf *mc)
+{
+  memset(mc, 0, sizeof(*mc));
+  if(getmlfq(mc) < 0){
+    printf(2, "mlfqctl: kernel not built with MLFQ_SCHED\n");
+    exit();
+  }
+}
+
+void
+apply(struct mlfqconf *mc)
+{
+  if(setmlfq(mc) < 0){
+    printf(2, "mlfqctl: settings rejected\n");
+    exit();
+  }
+  show();
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct mlfqconf mc;
+  int i;
+
+  if(argc < 2){
+    show();
+    exit();
+  }
+
+  if(strcmp(argv[1], "set") == 0){
+    if(argc < 4 || argc - 3 > NLEVEL){
+      printf(2, "usage: mlfqctl set boost q0 [q1 ...]\n");
+      exit();
+    }
+    current(&mc);
+    memset(mc.quantum, 0, sizeof(mc.quantum));
+    mc.boost = atoi(argv[2]);
+    mc.nlevel = argc - 3;
+    for(i = 0; i < mc.nlevel; i++)
+      mc.quantum[i] = atoi(argv[i + 3]);
+    apply(&mc);
+    exit();
+  }
+
+  if(strcmp(argv[1], "group") == 0){
+    if(argc != 3){
+      printf(2, "usage: mlfqctl group 0|1\n");
+      exit();
+    }
+    current(&mc);
+    mc.group = atoi(argv[2]);
+    apply(&mc);
+    exit();
+  }
+
+  for(i = 0; i < sizeof(profiles)/sizeof(profiles[0]); i++){
+    if(strcmp(argv[1], profiles[i].name) == 0){
+      current(&mc);
+      mc.nlevel = profiles[i].nlevel;
+      memmove(mc.quantum, profiles[i].quantum, sizeof(mc.quantum));
+      mc.boost = profiles[i].boost;
+      apply(&mc);
+      exit();
+    }
+  }
+
+  printf(2, "mlfqctl: unknown profile %s (classic, interactive, batch)\n",
+         argv[1]);
+  exit();
+}
@@ -0,0 +1,66 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NUM_SHORT 100
+#define NUM_WORKER 32
+#define NUM_PERIOD 100
+
+// 1. NUM_SHORT sleeps of 1ms should add up to about 10 ticks,
+//    not one tick each.
+// 2. NUM_WORKER periodic workers each sleeping one tick
+//    NUM_PERIOD times should finish in about NUM_PERIOD ticks.
+
+void shortsleeps(void)
+{
+  int i, start, elapsed;
+
+  start = uptime();
+  for (i = 0; i < NUM_SHORT; i++)
+  {
+    if (nanosleep(0, 1000000) < 0)
+    {
+      printf(1, "nanosleep failed\n");
+      exit();
+    }
+  }
+  elapsed = uptime() - start;
+  printf(1, "%d x 1ms: %d ticks\n", NUM_SHORT, elapsed);
+  if (elapsed > NUM_SHORT / 2)
+    printf(1, "short sleeps took too long\n");
+}
+
+void workers(void)
+{
+  int i, j, start, elapsed;
+
+  start = uptime();
+  for (i = 0; i < NUM_WORKER; i++)
+  {
+    if (fork() == 0)
+    {
+      for (j = 0; j < NUM_PERIOD; j++)
+        sleep(1);
+      exit();
+    }
+  }
+  for (i = 0; i < NUM_WORKER; i++)
+    wait();
+  elapsed = uptime() - start;
+  printf(1, "%d workers x %d periods: %d ticks\n", NUM_WORKER,
+         NUM_PERIOD, elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+  printf(1, "nanosleep test start\n");
+  if (nanosleep(0, 1000000000) == 0 || nanosleep(-1, 0) == 0)
+  {
+    printf(1, "bad arguments accepted\n");
+    exit();
+  }
+  shortsleeps();
+  workers();
+  printf(1, "nanosleep test finished\n");
+  exit();
+}
@@ -10,5 +10,14 @@
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       2000  // size of file system in blocks
+#define NLEVEL       16  // maximum number of MLFQ levels
+#define NPTY         11  // number of setpriority() values (0..10)
+#define BOOSTTICKS  100  // default ticks between MLFQ priority boosts
+#define NTICKETS    100  // tickets shared by stride processes and MLFQ
+#define MAXTICKETS   80  // most tickets stride processes may hold
+#define TICKNS 10000000  // nanoseconds per timer tick (100Hz)
+#define TLSSIZE      64  // bytes of thread-local storage on each stack
+#define NVMSEG        4  // ELF segments exec() maps lazily
+#define NKMCACHE      6  // kmalloc() size classes, 32 to 1024 bytes
 
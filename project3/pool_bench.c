@@ -0,0 +1,82 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define MAX_THREAD 60
+#define NUM_ROUND 20
+
+// Pool start-up time: MAX_THREAD-sized pools started with one
+// thread_create() per worker, then with one thread_create_many().
+
+int size[] = {4, 16, MAX_THREAD};
+thread_t thread[MAX_THREAD];
+void *arg[MAX_THREAD];
+
+void *worker(void *a)
+{
+  thread_exit(a);
+  return 0;
+}
+
+void joinall(int n)
+{
+  void *retval;
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (thread_join(thread[i], &retval) != 0 || (int)retval != i)
+    {
+      printf(1, "join of thread %d failed\n", i);
+      exit();
+    }
+}
+
+// Ticks spent starting NUM_ROUND pools of n threads.
+int startup(int n, int many)
+{
+  int r, i, elapsed;
+
+  elapsed = 0;
+  for (r = 0; r < NUM_ROUND; r++)
+  {
+    int start = uptime();
+
+    if (many)
+    {
+      if (thread_create_many(thread, n, worker, arg) != 0)
+      {
+        printf(1, "thread_create_many failed\n");
+        exit();
+      }
+    }
+    else
+    {
+      for (i = 0; i < n; i++)
+        if (thread_create(&thread[i], worker, arg[i]) != 0)
+        {
+          printf(1, "thread_create failed\n");
+          exit();
+        }
+    }
+    elapsed += uptime() - start;
+    joinall(n);
+  }
+  return elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+  int i, n;
+
+  printf(1, "pool bench start\n");
+  for (i = 0; i < MAX_THREAD; i++)
+    arg[i] = (void *)i;
+  for (i = 0; i < sizeof(size) / sizeof(size[0]); i++)
+  {
+    n = size[i];
+    printf(1, "%d threads x %d: thread_create %d ticks, thread_create_many %d ticks\n",
+           n, NUM_ROUND, startup(n, 0), startup(n, 1));
+  }
+  printf(1, "pool bench finished\n");
+  exit();
+}
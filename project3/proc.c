@@ -4,16 +4,64 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
+#include "traps.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "pstat.h"
+#include "mlfq.h"
+
+#if defined(MLFQ_SCHED) && K > NLEVEL
+#error "MLFQ_K is larger than NLEVEL"
+#endif
+
+#define STRIDE1 (1 << 20)  // stride of a single ticket
+#define RRTURNS 4          // RR picks a waiting FCFS process lets pass
+#define NSLEEPQ 64         // sleep queue buckets, a power of two
+#define NKSTACK 16         // kernel stacks kept for reuse
 
 struct {
   struct spinlock lock;
   struct proc proc[NPROC];
-  struct proc RR[NPROC];
-  struct proc FCFS[NPROC];
+  struct vmspace vm[NPROC];       // address spaces, free if ref is 0
+  struct runq sleepq[NSLEEPQ];    // sleepers hashed by chan
+#ifdef MULTILEVEL_SCHED
+  struct runq RR;                 // even pids, round robin
+  struct runq FCFS;               // odd pids, sorted by pid
+  int rrturns;                    // RR picks since FCFS last ran
+#endif
+#ifdef MLFQ_SCHED
+  struct runq mlfq[NLEVEL][NPTY]; // ready queues by level and priority
+  uint lvmap;                     // bit lv set if level lv has a ready process
+  uint ptymap[NLEVEL];            // bit pty set if mlfq[lv][pty] is non-empty
+  uint epoch;                     // last boostepoch applied to the queues
+  int nlevel;                     // levels in use, see setmlfq()
+  int quantum[NLEVEL];            // time quantum of each level
+  int group;                      // account per process, see setmlfq()
+  struct proc *stride[NPROC];     // min-heap of ready stride processes by pass
+  int nstride;                    // processes in the stride heap
+  int tickets;                    // tickets held by stride processes
+  uint mlfqpass;                  // pass of the MLFQ class as a whole
+  uint vtime;                     // pass of the last pick
+#endif
 } ptable;
 
+#if !defined(MULTILEVEL_SCHED) && !defined(MLFQ_SCHED)
+// Per-CPU ready queue of the default scheduler.
+// Lock order: ptable.lock, then a cpurq lock.
+struct cpurq {
+  struct spinlock lock;
+  struct runq q;
+  int n;                       // Number of queued processes
+} cpurq[NCPU];
+#endif
+
+// Kernel stacks of reaped processes, kept for allocproc().
+struct {
+  struct spinlock lock;
+  char *stack[NKSTACK];
+  int n;
+} kstacks;
+
 static struct proc *initproc;
 
 int nextpid = 1;
@@ -21,11 +69,29 @@ extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void setrunnable(struct proc *p);
+static int unqueue(struct proc *p);
+static void droptickets(struct proc *p);
+static struct runq *sleepq(void *chan);
+static void rqpush(struct runq *q, struct proc *p);
+static void rqremove(struct runq *q, struct proc *p);
 
 void
 pinit(void)
 {
   initlock(&ptable.lock, "ptable");
+  initlock(&kstacks.lock, "kstacks");
+#ifdef MLFQ_SCHED
+  int lv;
+  ptable.nlevel = K;
+  for(lv = 0; lv < NLEVEL; lv++)
+    ptable.quantum[lv] = lv*4 + 2;
+#endif
+#if !defined(MULTILEVEL_SCHED) && !defined(MLFQ_SCHED)
+  int i;
+  for(i = 0; i < NCPU; i++)
+    initlock(&cpurq[i].lock, "cpurq");
+#endif
 }
 // Must be called with interrupts disabled
 int
@@ -89,41 +155,67 @@ uptime(void)
   return xticks;
 }
 
-//PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
-// If found, change state to EMBRYO and initialize
-// state required to run in the kernel.
-// Otherwise return 0.
-static struct proc*
-allocproc(void)
+static char*
+kstackalloc(void)
 {
-  struct proc *p;
-  char *sp;
+  char *k = 0;
+
+  acquire(&kstacks.lock);
+  if(kstacks.n > 0)
+    k = kstacks.stack[--kstacks.n];
+  release(&kstacks.lock);
+  if(k == 0)
+    k = kalloc();
+  return k;
+}
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)  
-    if(p->state == UNUSED)
-      goto found;
-  release(&ptable.lock);
-  return 0;
+static void
+kstackfree(char *k)
+{
+  acquire(&kstacks.lock);
+  if(kstacks.n < NKSTACK){
+    kstacks.stack[kstacks.n++] = k;
+    k = 0;
+  }
+  release(&kstacks.lock);
+  if(k)
+    kfree(k);
+}
 
-found:
+//PAGEBREAK: 32
+// Claim the UNUSED proc p as an EMBRYO.
+// The ptable lock must be held.
+static void
+claimproc(struct proc *p)
+{
   p->state = EMBRYO;
   p->pid = nextpid++;
   p->level = 0;
   p->pty = 0;
   p->ticks = 0;
+  p->tickets = 0;
+  p->tls = 0;
+  p->utime = p->stime = 0;
+  p->nvcsw = p->nivcsw = 0;
+  p->waitticks = p->maxwait = 0;
+  memset(p->lvticks, 0, sizeof(p->lvticks));
   p->isThread=0;
   p->nextTid=0;
   p->tid=-1;
+  p->detached = 0;
+  p->cpumask = ~0;
+}
 
-  release(&ptable.lock);
+// Give an EMBRYO its kernel stack, set up to start executing
+// at forkret, which returns to trapret.
+static int
+kstackinit(struct proc *p)
+{
+  char *sp;
 
   // Allocate kernel stack.
-  if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
-    return 0;
-  }
+  if((p->kstack = kstackalloc()) == 0)
+    return -1;
   sp = p->kstack + KSTACKSIZE;
 
   // Leave room for trap frame.
@@ -139,10 +231,88 @@ found:
   p->context = (struct context*)sp;
   memset(p->context, 0, sizeof *p->context);
   p->context->eip = (uint)forkret;
+  return 0;
+}
+
+// Look in the process table for an UNUSED proc.
+// If found, change state to EMBRYO and initialize
+// state required to run in the kernel.
+// Otherwise return 0.
+static struct proc*
+allocproc(void)
+{
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)  
+    if(p->state == UNUSED)
+      goto found;
+  release(&ptable.lock);
+  return 0;
+
+found:
+  claimproc(p);
+  release(&ptable.lock);
 
+  if(kstackinit(p) < 0){
+    p->state = UNUSED;
+    return 0;
+  }
   return p;
 }
 
+// Take a free address space for a new process.
+// The ptable lock must be held.
+static struct vmspace*
+vmalloc(struct proc *main)
+{
+  struct vmspace *vm;
+
+  for(vm = ptable.vm; vm < &ptable.vm[NPROC]; vm++){
+    if(vm->ref == 0){
+      vm->ref = 1;
+      vm->pgdir = 0;
+      vm->sz = 0;
+      vm->main = main;
+      vm->nfreestack = 0;
+      vm->onq = 0;
+      vm->ready.head = vm->ready.tail = 0;
+      vm->zombies.head = vm->zombies.tail = 0;
+      vm->njoinable = 0;
+      vm->anyjoin = 0;
+      vm->reaper = 0;
+      vm->nfault = 0;
+      vm->nload = 0;
+      vm->ip = 0;
+      vm->nseg = 0;
+      return vm;
+    }
+  }
+  return 0;
+}
+
+// Drop p's reference to its address space; the last
+// thread out frees the page table. The ptable lock must be held.
+static void
+vmput(struct proc *p)
+{
+  struct vmspace *vm = p->vm;
+
+  p->vm = 0;
+  if(vm == 0)
+    return;
+  if(--vm->ref > 0){
+    //a thread that is gone leaves its stack to the next one.
+    if(p->isThread && vm->nfreestack < NPROC)
+      vm->freestack[vm->nfreestack++] = p->ustack;
+    return;
+  }
+  if(vm->pgdir)
+    freevm(vm->pgdir);
+  vm->pgdir = 0;
+  vm->main = 0;
+}
+
 //PAGEBREAK: 32
 // Set up first user process.
 void
@@ -154,21 +324,27 @@ userinit(void)
   p = allocproc();
   
   initproc = p;
-  if((p->pgdir = setupkvm()) == 0)
+  acquire(&ptable.lock);
+  p->vm = vmalloc(p);
+  release(&ptable.lock);
+  if((p->vm->pgdir = setupkvm()) == 0)
     panic("userinit: out of memory?");
-  inituvm(p->pgdir, _binary_initcode_start, (int)_binary_initcode_size);
-  p->sz = PGSIZE;
+  inituvm(p->vm->pgdir, _binary_initcode_start, (int)_binary_initcode_size);
+  p->vm->sz = PGSIZE;
   memset(p->tf, 0, sizeof(*p->tf));
   p->tf->cs = (SEG_UCODE << 3) | DPL_USER;
   p->tf->ds = (SEG_UDATA << 3) | DPL_USER;
   p->tf->es = p->tf->ds;
   p->tf->ss = p->tf->ds;
+  p->tf->gs = (SEG_UTLS << 3) | DPL_USER;
   p->tf->eflags = FL_IF;
   p->tf->esp = PGSIZE;
   p->tf->eip = 0;  // beginning of initcode.S
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
+  if((p->fdt = fdtalloc()) == 0)
+    panic("userinit: no fdtable");
 
   // this assignment to p->state lets other cores
   // run this process. the acquire forces the above
@@ -176,7 +352,7 @@ userinit(void)
   // because the assignment might not be atomic.
   acquire(&ptable.lock);
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&ptable.lock);
 }
@@ -187,26 +363,34 @@ int
 growproc(int n)
 {
   uint sz;
+  int i;
   struct proc *curproc = myproc();
+  struct vmspace *vm = curproc->vm;
+
+  //threads share vm, so they all see the new size at once.
   acquire(&ptable.lock);
-  sz = curproc->sz;
+  sz = vm->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    //only move the break; lazyfault() maps pages on first touch.
+    if(sz + n < sz || sz + n >= KERNBASE){
+      release(&ptable.lock);
       return -1;
+    }
+    sz += n;
   } else if(n < 0){
-    if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    if((sz = deallocuvm(vm->pgdir, sz, sz + n)) == 0){
+      release(&ptable.lock);
       return -1;
-  }
-  curproc->sz = sz;
-  
-  struct proc* p;
- 
-  //한thread의 주소공간이 늘어났을 때, 같은 프로세스의 있는 실행단위도 다 늘어나야한다.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == curproc -> pid){
-      p->sz = curproc->sz;
     }
   }
+  vm->sz = sz;
+  //free stacks above the new break are gone.
+  for(i = 0; i < vm->nfreestack; ){
+    if(vm->freestack[i] + 2*PGSIZE > sz)
+      vm->freestack[i] = vm->freestack[--vm->nfreestack];
+    else
+      i++;
+  }
   release(&ptable.lock);
   switchuvm(curproc);
   return 0;
@@ -218,7 +402,7 @@ growproc(int n)
 int
 fork(void)
 {
-  int i, pid;
+  int pid;
   struct proc *np;
   struct proc *curproc = myproc();
 
@@ -228,22 +412,36 @@ fork(void)
   }
 
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
-    kfree(np->kstack);
+  acquire(&ptable.lock);
+  np->vm = vmalloc(np);
+  release(&ptable.lock);
+  if(np->vm == 0 ||
+     (np->vm->pgdir = copyuvm(curproc->vm->pgdir, curproc->vm->sz,
+                              curproc->vm->ref == 1)) == 0 ||
+     (np->fdt = fdtcopy(curproc->fdt)) == 0){
+    acquire(&ptable.lock);
+    vmput(np);
+    release(&ptable.lock);
+    kstackfree(np->kstack);
     np->kstack = 0;
     np->state = UNUSED;
     return -1;
   }
-  np->sz = curproc->sz;
+  np->vm->sz = curproc->vm->sz;
+  //pages the parent never touched are still read from its program.
+  if(curproc->vm->ip){
+    np->vm->ip = idup(curproc->vm->ip);
+    memmove(np->vm->seg, curproc->vm->seg, sizeof(np->vm->seg));
+    np->vm->nseg = curproc->vm->nseg;
+  }
+  np->tls = curproc->tls;
+  np->cpumask = curproc->cpumask;
   np->parent = curproc;
   np->creator = np;
   *np->tf = *curproc->tf;
   // Clear %eax so that fork returns 0 in the child.
   np->tf->eax = 0;
 
-  for(i = 0; i < NOFILE; i++)
-    if(curproc->ofile[i])
-      np->ofile[i] = filedup(curproc->ofile[i]);
   np->cwd = idup(curproc->cwd);
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
@@ -252,7 +450,7 @@ fork(void)
 
   acquire(&ptable.lock);
 
-  np->state = RUNNABLE;
+  setrunnable(np);
 
   release(&ptable.lock);
 
@@ -267,24 +465,25 @@ exit(void)
 {
   struct proc *curproc = myproc();
   struct proc *p;
-  int fd;
 
   if(curproc == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(fd = 0; fd < NOFILE; fd++){
-    if(curproc->ofile[fd]){
-      fileclose(curproc->ofile[fd]);
-      curproc->ofile[fd] = 0;
-    }
-  }
-  killAll(curproc,0);
+  // The other threads go first, so this closes the open files.
+  if(killAll(curproc,0) < 0)
+    threadquit();
+  fdtclose(curproc->fdt);
+  curproc->fdt = 0;
   
   begin_op();
   iput(curproc->cwd);
+  //no thread is left to fault pages in from the program.
+  if(curproc->vm->ip)
+    iput(curproc->vm->ip);
   end_op();
   curproc->cwd = 0;
+  curproc->vm->ip = 0;
+  curproc->vm->nseg = 0;
 
   acquire(&ptable.lock);
 
@@ -300,6 +499,11 @@ exit(void)
     }
   }
 
+  droptickets(curproc);
+
+  // The parent reaps what is left of the process.
+  curproc->detached = 0;
+
   // Jump into the scheduler, never to return.
   curproc->state = ZOMBIE;
   sched();
@@ -323,12 +527,15 @@ wait(void)
       if(p->parent != curproc)
         continue;
       havekids = 1;
+      // A thread that exited is the process's only if it was last.
+      if(p->isThread && p->vm && p->vm->ref > 1)
+        continue;
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
-        kfree(p->kstack);
+        kstackfree(p->kstack);
         p->kstack = 0;
-        freevm(p->pgdir);
+        vmput(p);
         p->pid = 0;
         p->parent = 0;
         p->name[0] = 0;
@@ -352,97 +559,148 @@ wait(void)
 int
 thread_create(thread_t *thread, void*(*start_routine)(void *), void *arg)
 {
-  struct proc *np,*p;
+  return thread_create_many(thread, 1, start_routine, &arg);
+}
+
+// Start n threads at start_routine, thread i with arg[i], and
+// store their tids in thread[]. Takes all the proc slots in one
+// pass over the table and grows the address space once for all
+// the stacks it cannot reuse. All or nothing: 0 or -1.
+int
+thread_create_many(thread_t *thread, int n, void*(*start_routine)(void *), void **arg)
+{
+  struct proc *np[NPROC];
+  struct proc *p;
   struct proc *curproc = myproc();
-  uint sp, ustack[2];
+  struct vmspace *vm = curproc->vm;
+  uint sz, sp, stack, ustack[2];
+  int i, k;
 
-  // Allocate process.
-  if((np = allocproc()) == 0){
+  if(n < 1 || n > NPROC)
     return -1;
-  }
 
-  //let this thread share code, data with process/thread that creates it
-  np->pgdir = curproc->pgdir;
+  // Allocate processes.
   acquire(&ptable.lock);
-  
-  // Allocate user stack and guard page
-  if((curproc->sz = allocuvm(np->pgdir, curproc->sz, curproc->sz + 2*PGSIZE))==0){
-    return -1;
-  }
-  //after growing the proc, it cleans PTE_U of  guard page.
-  clearpteu(np->pgdir, (char*)(curproc->sz - 2*PGSIZE));
-  np->sz = curproc->sz;
-  sp = np->sz;
-
-  //같은 프로세스끼리 같은 pid를 공유
-  np->pid= curproc->pid;
-  
-  //지금 만드는 실행단위는 thread
-  np->isThread = 1;
-  //해당 thread의 부모 proc은 현재 thread를 만드는 proc의 부모
-  np->parent = curproc->parent; 
-  //해당 thread를 만드는 proc은 curproc
-  np->creator = curproc;
-  //해당 thread의 tid는 main thread가 가지고 있는 tid+1
-  if(curproc->isThread){
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->pid == curproc->pid && curproc->isThread!=0){
-        np->tid=curproc->nextTid++;
-        break;
-      }
+  for(k = 0, p = ptable.proc; p < &ptable.proc[NPROC] && k < n; p++){
+    if(p->state == UNUSED){
+      claimproc(p);
+      np[k++] = p;
     }
   }
-  else{
-    np->tid=curproc->nextTid++;
-  }
-  *thread=np->tid;
-  //해당 thread의 trap frame은 creator의 tf를 복사해옴.
-  *np->tf=*curproc->tf;
-  //user stack.
-  ustack[0]=0xffffffff;
-  ustack[1]=(uint)arg; 
-
-  sp-=8;
-
-  //8byte만큼 ustack를 sp로 복사한다.
-  //즉 user stack을 만든 내용을 sp위에다가 쌓는다.
-  if(copyout(np->pgdir,sp,ustack,8)<0)
-    return -1;
-
+  release(&ptable.lock);
+  for(i = 0; i < k; i++)
+    if(kstackinit(np[i]) < 0)
+      goto bad;
+  if(k < n)
+    goto bad;
+  //threads can't share a page table with copy-on-write pages in
+  //it: nothing would flush the other CPUs after a copy.
+  if(vm->ref == 1 && cowbreak(vm->pgdir, vm->sz) < 0)
+    goto bad;
 
-  //함수 시작 지점을 인자로 받은 start_routine함수로 지정한다.
-  np->tf->eip=(uint)start_routine;
-  //현재 stack pointer를 sp로 복사한다.
-  np->tf->esp=sp;
-  //생성된 thread입장에서의 thread_create함수의 return 값을 0으로 만든다.
-  np->tf->eax=0;
+  acquire(&ptable.lock);
 
-  //같은 프로세스끼리는 size가 같게 해줘서 주소공간을 공유함.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == curproc -> pid){
-      p->sz = curproc->sz;
+  // Reuse the stacks of joined threads, and allocate user stack
+  // and guard page for the rest in one go.
+  stack = vm->sz;
+  if(n > vm->nfreestack){
+    if((sz = allocuvm(vm->pgdir, vm->sz, vm->sz + (n - vm->nfreestack)*2*PGSIZE))==0){
+      release(&ptable.lock);
+      goto bad;
     }
+    //after growing the proc, it cleans PTE_U of the guard pages.
+    for(sp = vm->sz; sp < sz; sp += 2*PGSIZE)
+      clearpteu(vm->pgdir, (char*)sp);
+    vm->sz = sz;
   }
-  //동기화 된 pipe를 share하기 위함.
-  for(int i = 0; i < NOFILE; i++){
-    if(curproc->ofile[i])
-      np->ofile[i] = filedup(curproc->ofile[i]);
+  for(i = 0; i < n; i++){
+    if(vm->nfreestack > 0)
+      np[i]->ustack = vm->freestack[--vm->nfreestack];
+    else {
+      np[i]->ustack = stack;
+      stack += 2*PGSIZE;
+    }
   }
 
-  np->cwd = idup(curproc->cwd);
+  //동기화 된 pipe를 share하기 위함.
+  //the threads share one descriptor table.
+  fdtdup(curproc->fdt, n);
+
+  for(i = 0; i < n; i++){
+    p = np[i];
+
+    //the thread's local storage sits at the top of its stack.
+    sp = p->ustack + 2*PGSIZE - TLSSIZE;
+    if(tlsinit(vm->pgdir, sp) < 0)
+      panic("thread_create: tls");
+    p->tls = sp;
+
+    //let this thread share code, data with process/thread that creates it
+    p->vm = vm;
+    vm->ref++;
+    vm->njoinable++;
+
+    //같은 프로세스끼리 같은 pid를 공유
+    p->pid= curproc->pid;
+
+    //지금 만드는 실행단위는 thread
+    p->isThread = 1;
+    //해당 thread의 부모 proc은 현재 thread를 만드는 proc의 부모
+    p->parent = curproc->parent;
+    //해당 thread를 만드는 proc은 curproc
+    p->creator = curproc;
+    //해당 thread의 tid는 main thread가 가지고 있는 tid+1
+    p->tid=vm->main->nextTid++;
+    p->cpumask = curproc->cpumask;
+    thread[i]=p->tid;
+    //해당 thread의 trap frame은 creator의 tf를 복사해옴.
+    *p->tf=*curproc->tf;
+    //user stack.
+    ustack[0]=0xffffffff;
+    ustack[1]=(uint)arg[i];
+
+    sp-=8;
+
+    //8byte만큼 ustack를 sp로 복사한다.
+    //즉 user stack을 만든 내용을 sp위에다가 쌓는다.
+    if(copyout(vm->pgdir,sp,ustack,8)<0)
+      panic("thread_create: stack");
+
+    //함수 시작 지점을 인자로 받은 start_routine함수로 지정한다.
+    p->tf->eip=(uint)start_routine;
+    //현재 stack pointer를 sp로 복사한다.
+    p->tf->esp=sp;
+    //생성된 thread입장에서의 thread_create함수의 return 값을 0으로 만든다.
+    p->tf->eax=0;
+
+    p->fdt = curproc->fdt;
+    p->cwd = idup(curproc->cwd);
+
+    safestrcpy(p->name, curproc->name, sizeof(curproc->name));
+  }
 
-  safestrcpy(np->name, curproc->name, sizeof(curproc->name));
-  
   pushcli();
-  lcr3(V2P(np->pgdir));
+  lcr3(V2P(vm->pgdir));
   popcli();
 
-  np->state=RUNNABLE;
+  for(i = 0; i < n; i++)
+    setrunnable(np[i]);
 
   release(&ptable.lock);
 
   return 0;
 
+bad:
+  acquire(&ptable.lock);
+  for(i = 0; i < k; i++){
+    if(np[i]->kstack){
+      kstackfree(np[i]->kstack);
+      np[i]->kstack = 0;
+    }
+    np[i]->state = UNUSED;
+  }
+  release(&ptable.lock);
+  return -1;
 }
 void
 thread_exit(void *retval)
@@ -450,15 +708,10 @@ thread_exit(void *retval)
 
   struct proc * curproc=myproc();
   struct proc *p;
-  int fd;
 
-  // Close all open files.
-  for(fd = 0; fd < NOFILE; fd++){
-    if(curproc -> ofile[fd]){
-      fileclose(curproc -> ofile[fd]);
-      curproc -> ofile[fd] = 0;
-    }
-  }
+  // Let go of the shared open files.
+  fdtclose(curproc->fdt);
+  curproc->fdt = 0;
   begin_op();
   iput(curproc -> cwd);
   end_op();
@@ -468,8 +721,15 @@ thread_exit(void *retval)
   
   curproc->retval = retval;
 
-  // Parent might be sleeping in wait().
-  wakeup1(curproc->creator);
+  // A detached thread is freed by the scheduler once it is off
+  // its stack; the others wait to be joined, and only their own
+  // joiners are woken.
+  if(!curproc->detached){
+    rqpush(&curproc->vm->zombies, curproc);
+    wakeup1(curproc);
+    if(curproc->vm->anyjoin)
+      wakeup1(curproc->vm);
+  }
   
   // Pass abandoned children to init.
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
@@ -480,62 +740,182 @@ thread_exit(void *retval)
     }
   }
   
+  droptickets(curproc);
+
   // Jump into the scheduler, never to return.
   curproc->state=ZOMBIE;
   sched();
   panic("zombie exit");
 
 }
+// Free an exited thread. The ptable lock must be held.
+static void
+reapthread(struct proc *p)
+{
+  if(!p->detached){
+    rqremove(&p->vm->zombies, p);
+    p->vm->njoinable--;
+  }
+  kstackfree(p->kstack);
+  p->kstack = 0;
+  vmput(p);
+  p->pid = 0;
+  p->parent = 0;
+  p->creator = 0;
+  p->name[0] = 0;
+  p->killed = 0;
+  p->tid = 0;
+  p->detached = 0;
+  p->state = UNUSED;
+}
+
+// The joinable thread of this process with the given tid.
+static struct proc*
+findthread(thread_t thread)
+{
+  struct proc *curproc = myproc();
+  struct proc *p;
+
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    if(p->state != UNUSED && p->isThread && p->pid == curproc->pid &&
+       p->tid == thread && !p->detached && p != curproc)
+      return p;
+  return 0;
+}
+
 int
 thread_join(thread_t thread, void **retval){
 
   struct proc *p;
   struct proc *curproc = myproc();
   acquire(&ptable.lock);
-  for(;;){
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->tid != thread)
-        continue;
-      if(p->state == ZOMBIE){
-        *retval=p->retval;
-        kfree(p->kstack);
-        p->kstack = 0;
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
-        release(&ptable.lock);
-        return 0;
-      }
+  if((p = findthread(thread)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  while(p->state != ZOMBIE){
+    // Wait for it to exit.  (See wakeup1 call in thread_exit.)
+    sleep(p, &ptable.lock);
+    // It may have been detached or joined by thread_join_any().
+    if(curproc->killed || findthread(thread) != p){
+      release(&ptable.lock);
+      return -1;
     }
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
-    sleep(curproc, &ptable.lock);  //DOC: wait-sleep
   }
-  return -1;
+  *retval=p->retval;
+  reapthread(p);
+  release(&ptable.lock);
+  return 0;
 }
 
-struct proc * getMainThread(struct proc * curproc){
+// Join whichever thread of this process exited first and
+// return its tid; -1 if no other joinable thread is left.
+int
+thread_join_any(void **retval)
+{
+  struct proc *curproc = myproc();
+  struct vmspace *vm = curproc->vm;
+  struct proc *p;
+  thread_t tid;
 
   acquire(&ptable.lock);
-  struct proc* p = curproc;
-  for(p = ptable.proc; p<&ptable.proc[NPROC]; p++){
-    if(p->pid == curproc->pid && p->isThread==0)
-      break;
+  while((p = vm->zombies.head) == 0){
+    if(vm->njoinable - (curproc->isThread && !curproc->detached) <= 0 ||
+       curproc->killed){
+      release(&ptable.lock);
+      return -1;
+    }
+    vm->anyjoin++;
+    sleep(vm, &ptable.lock);
+    vm->anyjoin--;
   }
-  return p;
+  tid = p->tid;
+  *retval = p->retval;
+  reapthread(p);
   release(&ptable.lock);
+  return tid;
 }
 
-void killAll(struct proc * curproc, int selfKill){
+// Let the kernel free the thread when it exits; one that
+// already has is freed now.
+int
+thread_detach(thread_t thread)
+{
+  struct vmspace *vm = myproc()->vm;
+  struct proc *p;
 
   acquire(&ptable.lock);
+  if((p = findthread(thread)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  if(p->state == ZOMBIE)
+    reapthread(p);
+  else {
+    p->detached = 1;
+    vm->njoinable--;
+    //joiners waiting on it, or on nothing now, give up.
+    wakeup1(p);
+    if(vm->anyjoin)
+      wakeup1(vm);
+  }
+  release(&ptable.lock);
+  return 0;
+}
+
+struct proc * getMainThread(struct proc * curproc){
+  return curproc->vm->main;
+}
+
+// Free the other threads of curproc's process. One that is
+// RUNNING on another CPU is only marked killed; its stack and
+// address space are in use until it is off the CPU, so this
+// waits for it and frees it then. Returns -1 if another thread
+// is already doing this for the process: curproc is then one
+// of the threads it frees and must stop (see threadquit()).
+int killAll(struct proc * curproc, int selfKill){
+
+  struct vmspace *vm = curproc->vm;
   struct proc* p;
-  //kill all the thread that shares same process without itself
-  for(p = ptable.proc; p<&ptable.proc[NPROC]; p++){
-    if(p->pid == curproc->pid && p->tid != curproc->tid){
+  int running;
+
+  //tickslock comes first, for the timers of sleeping threads.
+  acquire(&tickslock);
+  acquire(&ptable.lock);
+  if(vm->reaper && vm->reaper != curproc){
+    release(&ptable.lock);
+    release(&tickslock);
+    return -1;
+  }
+  vm->reaper = curproc;
+  for(;;){
+    running = 0;
+    //kill all the thread that shares same process without itself
+    for(p = ptable.proc; p<&ptable.proc[NPROC]; p++){
+      if(p->pid != curproc->pid || p->tid == curproc->tid)
+        continue;
+      if(p->state == RUNNING){
+        p->killed = 1;
+        running = 1;
+        continue;
+      }
+      if(p->state == RUNNABLE)
+        unqueue(p);
+      if(p->state == SLEEPING)
+        rqremove(sleepq(p->chan), p);
+      if(p->state == ZOMBIE)
+        rqremove(&p->vm->zombies, p);
+      if(p->isThread && !p->detached)
+        p->vm->njoinable--;
+      //curproc still holds the descriptor table.
+      if(p->fdt){
+        fdtdrop(p->fdt);
+        p->fdt = 0;
+      }
+      timerdel(&p->timer);
+      droptickets(p);
       if(p->kstack != 0){
-        kfree(p->kstack);
+        kstackfree(p->kstack);
       }
       p->kstack=0;
       p->pid=0;
@@ -543,61 +923,708 @@ void killAll(struct proc * curproc, int selfKill){
       p->creator=0;
       p->name[0]=0;
       p->killed=0;
+      p->detached=0;
+      vmput(p);
       p->state=UNUSED;
-      p->sz=0;
       p->tid=0;
     }
+    if(!running)
+      break;
+    //sched() wakes us when a thread of vm leaves its CPU.
+    release(&tickslock);
+    sleep(&vm->reaper, &ptable.lock);
+    release(&ptable.lock);
+    acquire(&tickslock);
+    acquire(&ptable.lock);
   }
+  vm->reaper = 0;
   release(&ptable.lock);
+  release(&tickslock);
+  return 0;
+}
+
+// Stop curproc for the thread that is freeing it in killAll().
+// Its resources are freed there. Does not return.
+void
+threadquit(void)
+{
+  struct proc *curproc = myproc();
 
+  acquire(&ptable.lock);
+  //killAll() takes it off the zombie list like any other.
+  if(!curproc->detached)
+    rqpush(&curproc->vm->zombies, curproc);
+  curproc->state = ZOMBIE;
+  sched();
+  panic("zombie exit");
 }
 
-//PAGEBREAK: 42
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run
-//  - swtch to start running that process
-//  - eventually that process transfers control
-//      via swtch back to the scheduler.
-int 
-checkRR(void)
+// Sleeping processes are off the run queues, so they use the
+// same links on the queue of their chan's bucket.
+static struct runq*
+sleepq(void *chan)
 {
-  struct proc * p;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid %2  == 0 && p->state == RUNNABLE)
-       return 1;
-  }
-  return 0; 
+  return &ptable.sleepq[(((uint)chan >> 2) * 2654435761u >> 16) & (NSLEEPQ-1)];
 }
 
-void
-priority_boosting(void)
+static void
+rqpush(struct runq *q, struct proc *p)
 {
-  struct proc * p;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state != RUNNABLE)
-      continue;
-    p->level = 0;
-    p->ticks = 0;
-  }
+  p->next = 0;
+  p->prev = q->tail;
+  if(q->tail)
+    q->tail->next = p;
+  else
+    q->head = p;
+  q->tail = p;
 }
 
+static void
+rqremove(struct runq *q, struct proc *p)
+{
+  if(p->prev)
+    p->prev->next = p->next;
+  else
+    q->head = p->next;
+  if(p->next)
+    p->next->prev = p->prev;
+  else
+    q->tail = p->prev;
+  p->next = 0;
+  p->prev = 0;
+}
 
-int
-smallestQ(void)
+// May p run on CPU self?
+static int
+canrun(struct proc *p, int self)
+{
+  return (p->cpumask >> self) & 1;
+}
+
+// The first process on q that may run on CPU self.
+static struct proc*
+firstfor(struct runq *q, int self)
 {
   struct proc *p;
-  int lv = 5;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state != RUNNABLE)
+
+  for(p = q->head; p && !canrun(p, self); p = p->next)
+    ;
+  return p;
+}
+
+#ifdef MLFQ_SCHED
+// Take a boost p has missed: a process that was queued when
+// priority_boosting() ran now sits on level 0, whatever p->level
+// says, and a sleeping one is boosted when it is queued again.
+// Also pulls p into range if setmlfq() dropped its level.
+static void
+boostcheck(struct proc *p)
+{
+  if(p->epoch != ptable.epoch){
+    p->epoch = ptable.epoch;
+    p->level = 0;
+    p->ticks = 0;
+  }
+  if(p->level >= ptable.nlevel)
+    p->level = ptable.nlevel - 1;
+}
+
+// Append p to the queue of its level and priority.
+static void
+mlfqpush(struct proc *p)
+{
+  boostcheck(p);
+  rqpush(&ptable.mlfq[p->level][p->pty], p);
+  ptable.ptymap[p->level] |= 1 << p->pty;
+  ptable.lvmap |= 1 << p->level;
+}
+
+static void
+mlfqremove(struct proc *p)
+{
+  struct runq *q;
+
+  boostcheck(p);
+  q = &ptable.mlfq[p->level][p->pty];
+  rqremove(q, p);
+  if(q->head == 0){
+    ptable.ptymap[p->level] &= ~(1 << p->pty);
+    if(ptable.ptymap[p->level] == 0)
+      ptable.lvmap &= ~(1 << p->level);
+  }
+}
+
+// The greatest priority process of the lowest non-empty level.
+static struct proc*
+mlfqpick(int self)
+{
+  struct proc *p;
+  int lv, pty;
+
+  if(ptable.lvmap == 0)
+    return 0;
+  lv = bsf(ptable.lvmap);
+  p = ptable.mlfq[lv][bsr(ptable.ptymap[lv])].head;
+  if(canrun(p, self))
+    return p;
+  //the best one is pinned elsewhere: walk the queues in order.
+  for(lv = 0; lv < NLEVEL; lv++){
+    if((ptable.lvmap & (1 << lv)) == 0)
+      continue;
+    for(pty = NPTY-1; pty >= 0; pty--)
+      if((p = firstfor(&ptable.mlfq[lv][pty], self)) != 0)
+        return p;
+  }
+  return 0;
+}
+
+static void
+rqsplice(struct runq *dst, struct runq *src)
+{
+  if(src->head == 0)
+    return;
+  if(dst->tail){
+    dst->tail->next = src->head;
+    src->head->prev = dst->tail;
+  } else
+    dst->head = src->head;
+  dst->tail = src->tail;
+  src->head = 0;
+  src->tail = 0;
+}
+
+// Apply the boosts the timer has announced since the last call
+// by moving every queue onto level 0. Costs NLEVEL*NPTY list
+// splices no matter how many processes there are; per-process
+// state is fixed up lazily by boostcheck().
+static void
+priority_boosting(void)
+{
+  int lv, pty;
+  uint epoch = boostepoch;
+
+  if(ptable.epoch == epoch)
+    return;
+  for(lv = 1; lv < NLEVEL; lv++){
+    if((ptable.lvmap & (1 << lv)) == 0)
+      continue;
+    for(pty = 0; pty < NPTY; pty++)
+      rqsplice(&ptable.mlfq[0][pty], &ptable.mlfq[lv][pty]);
+    ptable.ptymap[0] |= ptable.ptymap[lv];
+    ptable.ptymap[lv] = 0;
+  }
+  if(ptable.lvmap)
+    ptable.lvmap = 1;
+  ptable.epoch = epoch;
+}
+
+// Passes wrap around; compare them by their difference.
+static int
+passbefore(uint a, uint b)
+{
+  return (int)(a - b) < 0;
+}
+
+static void
+heapswap(int i, int j)
+{
+  struct proc *p = ptable.stride[i];
+
+  ptable.stride[i] = ptable.stride[j];
+  ptable.stride[j] = p;
+  ptable.stride[i]->stridx = i;
+  ptable.stride[j]->stridx = j;
+}
+
+static void
+siftup(int i)
+{
+  while(i > 0 && passbefore(ptable.stride[i]->pass,
+                            ptable.stride[(i-1)/2]->pass)){
+    heapswap(i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+static void
+siftdown(int i)
+{
+  int c, min;
+
+  for(;;){
+    min = i;
+    for(c = 2*i + 1; c <= 2*i + 2 && c < ptable.nstride; c++)
+      if(passbefore(ptable.stride[c]->pass, ptable.stride[min]->pass))
+        min = c;
+    if(min == i)
+      return;
+    heapswap(i, min);
+    i = min;
+  }
+}
+
+// Add p to the stride heap. A process that slept or just joined
+// starts at the current virtual time, so it cannot spend the
+// share it did not use while away.
+static void
+stridepush(struct proc *p)
+{
+  if(passbefore(p->pass, ptable.vtime))
+    p->pass = ptable.vtime;
+  p->stridx = ptable.nstride++;
+  ptable.stride[p->stridx] = p;
+  siftup(p->stridx);
+}
+
+static void
+strideremove(struct proc *p)
+{
+  int i = p->stridx;
+
+  if(i != --ptable.nstride){
+    ptable.stride[i] = ptable.stride[ptable.nstride];
+    ptable.stride[i]->stridx = i;
+    siftdown(i);
+    siftup(i);
+  }
+}
+
+// Whose level and ticks a run of p is charged to: in group
+// mode the main thread's stand for the whole process.
+static struct proc*
+mlfqacct(struct proc *p)
+{
+  return ptable.group ? p->vm->main : p;
+}
+
+// In group mode a process holds a single place on the MLFQ
+// queues, so it gets one turn per round and one CPU however
+// many threads it has. The place goes to one runnable thread
+// and stays with it while it runs; the others wait on the
+// group's ready list.
+static void
+grouppush(struct proc *p)
+{
+  struct vmspace *vm = p->vm;
+  struct proc *a = mlfqacct(p);
+
+  if(vm->onq){
+    rqpush(&vm->ready, p);
+    return;
+  }
+  boostcheck(a);
+  p->level = a->level;
+  p->epoch = a->epoch;
+  vm->onq = p;
+  mlfqpush(p);
+}
+
+static void
+groupremove(struct proc *p)
+{
+  struct vmspace *vm = p->vm;
+  struct proc *next;
+
+  if(vm->onq != p){
+    rqremove(&vm->ready, p);
+    return;
+  }
+  mlfqremove(p);
+  vm->onq = 0;
+  if((next = vm->ready.head) != 0){
+    rqremove(&vm->ready, next);
+    grouppush(next);
+  }
+}
+
+// Stride processes and the MLFQ class compete by pass: the MLFQ
+// class is one more participant holding the tickets nobody
+// reserved, and inside its share the MLFQ rules apply as before.
+static void
+classpush(struct proc *p)
+{
+  if(p->tickets){
+    stridepush(p);
+    return;
+  }
+  //an MLFQ class coming back from empty starts at the virtual time too.
+  if(ptable.lvmap == 0 && passbefore(ptable.mlfqpass, ptable.vtime))
+    ptable.mlfqpass = ptable.vtime;
+  if(ptable.group)
+    grouppush(p);
+  else
+    mlfqpush(p);
+}
+
+static void
+classremove(struct proc *p)
+{
+  if(p->tickets)
+    strideremove(p);
+  else if(ptable.group)
+    groupremove(p);
+  else
+    mlfqremove(p);
+}
+
+// Take p, just picked, off the queues to run it. In group mode
+// it keeps its group's place until grouprelease().
+static void
+classtake(struct proc *p)
+{
+  if(p->tickets)
+    strideremove(p);
+  else
+    mlfqremove(p);
+}
+
+// p held its group's place while it ran and is now off the CPU.
+// Hand the place to the first waiting sibling, p going behind
+// the others if it is still runnable.
+static void
+grouprelease(struct proc *p)
+{
+  struct vmspace *vm = p->vm;
+  struct proc *next;
+
+  vm->onq = 0;
+  if(p->state == RUNNABLE){
+    if(ptable.group && p->tickets == 0)
+      rqpush(&vm->ready, p);
+    else
+      classpush(p);
+  }
+  if((next = vm->ready.head) != 0){
+    rqremove(&vm->ready, next);
+    grouppush(next);
+  }
+}
+
+// The stride process with the smallest pass that may run on
+// CPU self. Off the heap top that takes a scan of the heap.
+static struct proc*
+stridepick(int self)
+{
+  struct proc *s, *p;
+  int i;
+
+  if(ptable.nstride == 0 || canrun(ptable.stride[0], self))
+    return ptable.nstride ? ptable.stride[0] : 0;
+  s = 0;
+  for(i = 1; i < ptable.nstride; i++){
+    p = ptable.stride[i];
+    if(canrun(p, self) && (s == 0 || passbefore(p->pass, s->pass)))
+      s = p;
+  }
+  return s;
+}
+
+// The stride process with the smallest pass, unless the MLFQ
+// class is further behind; then MLFQ picks as usual.
+static struct proc*
+classpick(int self)
+{
+  struct proc *s, *m;
+
+  s = stridepick(self);
+  m = mlfqpick(self);
+  if(s && (m == 0 || passbefore(s->pass, ptable.mlfqpass))){
+    ptable.vtime = s->pass;
+    return s;
+  }
+  if(m)
+    ptable.vtime = ptable.mlfqpass;
+  return m;
+}
+
+#elif !defined(MULTILEVEL_SCHED)
+// Append p to the ready queue of the CPU it last ran on.
+static void
+cpupush(struct proc *p)
+{
+  struct cpurq *rq = &cpurq[p->cpu];
+
+  acquire(&rq->lock);
+  rqpush(&rq->q, p);
+  rq->n++;
+  release(&rq->lock);
+}
+
+// Take the process that has waited longest and may run on
+// CPU self off rq, if any.
+static struct proc*
+cpupop(struct cpurq *rq, int self)
+{
+  struct proc *p;
+
+  acquire(&rq->lock);
+  if((p = firstfor(&rq->q, self)) != 0){
+    rqremove(&rq->q, p);
+    rq->n--;
+  }
+  release(&rq->lock);
+  return p;
+}
+
+// Remove p from its CPU's queue. Returns 0 if a scheduler
+// has already popped it and is about to run it.
+static int
+cpuremove(struct proc *p)
+{
+  struct cpurq *rq = &cpurq[p->cpu];
+  int queued;
+
+  acquire(&rq->lock);
+  if((queued = (p->prev != 0 || rq->q.head == p)) != 0){
+    rqremove(&rq->q, p);
+    rq->n--;
+  }
+  release(&rq->lock);
+  return queued;
+}
+
+// Steal from the CPU with the longest ready queue, or from
+// any other if everything there is pinned elsewhere.
+// The lengths are read without locks; cpupop rechecks.
+static struct proc*
+steal(int self)
+{
+  int i, n, most = 0;
+  struct cpurq *busiest = 0;
+  struct proc *p;
+
+  for(i = 0; i < ncpu; i++){
+    n = cpurq[i].n;
+    if(i != self && n > most){
+      most = n;
+      busiest = &cpurq[i];
+    }
+  }
+  if(busiest == 0)
+    return 0;
+  if((p = cpupop(busiest, self)) != 0)
+    return p;
+  for(i = 0; i < ncpu; i++)
+    if(i != self && &cpurq[i] != busiest && cpurq[i].n > 0 &&
+       (p = cpupop(&cpurq[i], self)) != 0)
+      return p;
+  return 0;
+}
+
+// CPU in mask with the shortest ready queue, for new processes.
+static int
+leastloaded(uint mask)
+{
+  int i, best = -1;
+
+  for(i = 0; i < ncpu; i++)
+    if(((mask >> i) & 1) && (best < 0 || cpurq[i].n < cpurq[best].n))
+      best = i;
+  return best < 0 ? 0 : best;
+}
+
+#else
+// Even pids go round robin on RR, odd pids first come first
+// served on FCFS: the smallest pid runs until it blocks.
+static void
+mlpush(struct proc *p)
+{
+  struct runq *q = &ptable.FCFS;
+  struct proc *at;
+
+  if(p->pid % 2 == 0){
+    rqpush(&ptable.RR, p);
+    return;
+  }
+  //new processes have the largest pid, so most inserts stop at once.
+  for(at = q->tail; at && at->pid > p->pid; at = at->prev)
+    ;
+  p->prev = at;
+  p->next = at ? at->next : q->head;
+  if(p->next)
+    p->next->prev = p;
+  else
+    q->tail = p;
+  if(at)
+    at->next = p;
+  else
+    q->head = p;
+}
+
+static void
+mlremove(struct proc *p)
+{
+  rqremove(p->pid % 2 == 0 ? &ptable.RR : &ptable.FCFS, p);
+}
+
+// RR goes first, but a waiting FCFS process gets a turn
+// after RRTURNS RR picks so it cannot starve.
+static struct proc*
+mlpick(int self)
+{
+  struct proc *rr = firstfor(&ptable.RR, self);
+  struct proc *fcfs = firstfor(&ptable.FCFS, self);
+
+  if(rr && (fcfs == 0 || ptable.rrturns < RRTURNS)){
+    if(fcfs)
+      ptable.rrturns++;
+    return rr;
+  }
+  ptable.rrturns = 0;
+  return fcfs;
+}
+#endif
+
+// Is there anything this CPU could run? Work pinned to other
+// CPUs does not count, or this one would never halt. Empty queues
+// are seen without locks; the queued processes are checked with
+// canrun() under the lock, as the dispatcher does.
+static int
+haswork(int self)
+{
+  int r;
+#ifdef MLFQ_SCHED
+  if(ptable.lvmap == 0 && ptable.nstride == 0)
+    return 0;
+  acquire(&ptable.lock);
+  r = mlfqpick(self) != 0 || stridepick(self) != 0;
+  release(&ptable.lock);
+#elif !defined(MULTILEVEL_SCHED)
+  int i;
+
+  r = 0;
+  for(i = 0; i < ncpu && !r; i++){
+    if(cpurq[i].n == 0)
       continue;
-    if(p->level < lv)
-      lv = p->level;
+    acquire(&cpurq[i].lock);
+    r = firstfor(&cpurq[i].q, self) != 0;
+    release(&cpurq[i].lock);
+  }
+#else
+  if(ptable.RR.head == 0 && ptable.FCFS.head == 0)
+    return 0;
+  acquire(&ptable.lock);
+  r = firstfor(&ptable.RR, self) != 0 || firstfor(&ptable.FCFS, self) != 0;
+  release(&ptable.lock);
+#endif
+  return r;
+}
+
+// Is other work queued that this CPU might run? An unlocked
+// hint for busy waits that should give the CPU up.
+int
+needresched(void)
+{
+#ifdef MLFQ_SCHED
+  return ptable.lvmap != 0 || ptable.nstride != 0;
+#elif !defined(MULTILEVEL_SCHED)
+  int self;
+
+  pushcli();
+  self = cpuid();
+  popcli();
+  return cpurq[self].n > 0;
+#else
+  return ptable.RR.head != 0 || ptable.FCFS.head != 0;
+#endif
+}
+
+// Nothing to run: halt until the next interrupt instead of
+// spinning on the ready queues. The timer tick or an IRQ_WAKEUP
+// from kick() brings the CPU back.
+static void
+idle(struct cpu *c)
+{
+  cli();
+  // xchg orders the store to c->idle before the reads in
+  // haswork(), so a waker either sees idle set or we see its work.
+  xchg(&c->idle, 1);
+  if(!haswork(c - cpus)){
+    c->halts++;
+    stihlt();
   }
-  return lv;
+  c->idle = 0;
 }
 
+// Make sure some CPU notices newly queued work: the CPU that
+// owns the queue if it is halted, else any other halted CPU in
+// mask.
+static void
+kick(int target, uint mask)
+{
+  int i;
+
+  if(target >= 0 && !cpus[target].idle)
+    target = -1;
+  for(i = 0; target < 0 && i < ncpu; i++)
+    if(cpus[i].idle && ((mask >> i) & 1))
+      target = i;
+  if(target >= 0)
+    lapicipi(cpus[target].apicid, T_IRQ0 + IRQ_WAKEUP);
+}
+
+// Mark p RUNNABLE and put it on the ready queue.
+// The ptable lock must be held.
+static void
+setrunnable(struct proc *p)
+{
+  p->readyat = ticks;
+#ifdef MLFQ_SCHED
+  p->state = RUNNABLE;
+  classpush(p);
+  kick(-1, p->cpumask);
+#elif !defined(MULTILEVEL_SCHED)
+  //a new process goes to the least loaded CPU,
+  //a woken one back to the CPU it last ran on
+  //unless its affinity has moved it away.
+  if(p->state == EMBRYO || !canrun(p, p->cpu))
+    p->cpu = leastloaded(p->cpumask);
+  p->state = RUNNABLE;
+  cpupush(p);
+  kick(p->cpu, p->cpumask);
+#else
+  p->state = RUNNABLE;
+  mlpush(p);
+  kick(-1, p->cpumask);
+#endif
+}
+
+// Take a RUNNABLE p off the ready queue. Returns 0 if p
+// was not queued because a scheduler is about to run it.
+// The ptable lock must be held.
+static int
+unqueue(struct proc *p)
+{
+#ifdef MLFQ_SCHED
+  classremove(p);
+  return 1;
+#elif !defined(MULTILEVEL_SCHED)
+  return cpuremove(p);
+#else
+  mlremove(p);
+  return 1;
+#endif
+}
+
+// p is about to run: charge the time it waited for a CPU.
+static void
+dispatched(struct proc *p)
+{
+  uint w = ticks - p->readyat;
+
+  p->waitticks += w;
+  if(w > p->maxwait)
+    p->maxwait = w;
+}
+
+//PAGEBREAK: 42
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - choose a process to run
+//  - swtch to start running that process
+//  - eventually that process transfers control
+//      via swtch back to the scheduler.
 #ifdef MULTILEVEL_SCHED
 void
 scheduler(void)
@@ -610,45 +1637,25 @@ scheduler(void)
     // Enable interrupts on this processor.
     
     sti();
-    // Loop over process table looking for process to run.
     acquire(&ptable.lock);
-    struct proc *tmp = 0;
-    int pid = 10000;
-   
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->pid %2 ==0 &&p->state == RUNNABLE){
-        c->proc = p;
-        switchuvm(p);
-        p->state = RUNNING;
-
-        swtch(&(c->scheduler), p->context);
-        switchkvm();
-
-        c->proc = 0;
-      }
-    }
-
-    int check;
-    check = checkRR();
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(check == 1)
-	      break;
-      if(p->state != RUNNABLE)
-	      continue;
-      if(p->pid< pid && p->pid > 0){
-        tmp = p;
-        pid = p->pid;
-      }
-    }
-    if(tmp){
-      c -> proc = tmp;
-      switchuvm(tmp);
-      tmp->state = RUNNING;
-      swtch(&(c->scheduler), tmp->context);
+    if((p = mlpick(c - cpus)) != 0){
+      mlremove(p);
+      c->proc = p;
+      switchuvm(p);
+      p->state = RUNNING;
+      dispatched(p);
+      swtch(&(c->scheduler), p->context);
       switchkvm();
-      c->proc=0;
+      c->proc = 0;
+      //RR goes to the back of its queue, FCFS back to its place.
+      if(p->state == RUNNABLE)
+        mlpush(p);
+      else if(p->state == ZOMBIE && p->detached)
+        reapthread(p);
     }
     release(&ptable.lock);
+    if(p == 0)
+      idle(c);
   }
 }
 
@@ -656,53 +1663,60 @@ scheduler(void)
 void
 scheduler(void)
 {
-  struct proc *p;
+  struct proc *p, *a;
+  int queued;
 
   struct cpu *c = mycpu();
   c->proc = 0;
-  int startTime = uptime();
 
   for(;;){
     // Enable interrupts on this processor.
     
     sti();
-    // Loop over process table looking for process to run.
     acquire(&ptable.lock);
-    struct proc *tmp = 0;
-    int pty = -1; 
-    int currentlv = smallestQ();
+    priority_boosting();
     //select the greatest priority Process of the lowest queue.
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      //process that not runnable or running won't be considered
-      if(p->state != RUNNABLE && p->state != RUNNING)
-	      continue;
-      if(p->level != currentlv || currentlv >= K)
-        continue;
-      else if(p->pty > pty && p->pid > 0){
-        tmp = p;
-        pty = p->pty;
-      }
-    }
-    //tmp contains smallest queue, biggest priority
-    if(tmp){
-
-      c -> proc = tmp;
-      switchuvm(tmp);
-      tmp->state = RUNNING;
-      tmp->ticks += 1;
-      swtch(&(c->scheduler), tmp->context);
+    if((p = classpick(c - cpus)) != 0){
+      classtake(p);
+      c -> proc = p;
+      switchuvm(p);
+      p->state = RUNNING;
+      dispatched(p);
+      swtch(&(c->scheduler), p->context);
       switchkvm();
       c->proc=0;
-      if(tmp->ticks >= (currentlv*4 + 2)){
-        tmp->ticks = 0;
-        tmp->level++;
+      //charge the tick to p's class.
+      if(p->tickets)
+        p->pass += STRIDE1 / p->tickets;
+      else {
+        ptable.mlfqpass += STRIDE1 / (NTICKETS - ptable.tickets);
+        a = mlfqacct(p);
+        //a main thread queued as its group's place moves with its level.
+        queued = a != p && a->state == RUNNABLE && a->vm->onq == a;
+        if(queued)
+          mlfqremove(a);
+        boostcheck(a);
+        a->ticks += 1;
+        if(a->ticks >= ptable.quantum[a->level]){
+          a->ticks = 0;
+          if(a->level < ptable.nlevel - 1)
+            a->level++;
+        }
+        if(queued)
+          mlfqpush(a);
       }
-    }
-    if(uptime() >= 100 + startTime){
-      priority_boosting();
-      startTime = uptime();
+      //yield() leaves p RUNNABLE but off the queues until its
+      //context is saved; requeue it at its (possibly new) level.
+      if(p->vm && p->vm->onq == p)
+        grouprelease(p);
+      else if(p->state == RUNNABLE)
+        classpush(p);
+      if(p->state == ZOMBIE && p->detached)
+        reapthread(p);
     }
     release(&ptable.lock);
+    if(p == 0)
+      idle(c);
   }
 }
 
@@ -712,26 +1726,32 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int self = c - cpus;
   c->proc = 0;
   for(;;){
     // Enable interrupts on this processor.
     
     sti();
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
+    // Take from this CPU's queue; steal only when it is empty.
+    // Neither touches ptable.lock.
+    if((p = cpupop(&cpurq[self], self)) == 0 && (p = steal(self)) == 0){
+      idle(c);
+      continue;
+    }
 
-   
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
-      //ptable.RR[idxR] = *pr;
-      //idxR ++;
+    acquire(&ptable.lock);
+    // p may have been killed after it left the queue, and
+    // its slot even reused and queued again by fork().
+    if(p->state == RUNNABLE){
+      cpuremove(p);
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
       // before jumping back to us.
+      p->cpu = self;
       c->proc = p;
       switchuvm(p);
       p->state = RUNNING;
+      dispatched(p);
 
       swtch(&(c->scheduler), p->context);
       switchkvm();
@@ -739,8 +1759,13 @@ scheduler(void)
       // Process is done running for now.
       // It should have changed its p->state before coming back.
       c->proc = 0;
+      if(p->state == RUNNABLE && canrun(p, self))
+        cpupush(p);
+      else if(p->state == RUNNABLE)
+        setrunnable(p);
+      else if(p->state == ZOMBIE && p->detached)
+        reapthread(p);
     }
-
     release(&ptable.lock);
   }
 }
@@ -751,21 +1776,197 @@ int
 setpriority(int pid, int pty)
 {
   struct proc *p;
+  int queued;
+  acquire(&ptable.lock);
   for(p= ptable.proc; p<&ptable.proc[NPROC];p++){
     if(p->pid==pid&&p->parent->pid == myproc()->pid){
+      //a queued process moves to the queue of its new priority.
+      queued = p->state == RUNNABLE && unqueue(p);
       p->pty = pty;
+      if(queued)
+        setrunnable(p);
+      release(&ptable.lock);
       return 0;
     }
   }
+  release(&ptable.lock);
+  return -1;
+}
+
+// Let the calling thread (pid 0) or every thread of process
+// pid run only on the CPUs in mask. New threads and children
+// inherit the mask of their creator.
+int
+setaffinity(int pid, uint mask)
+{
+  struct proc *p, *curproc = myproc();
+  int found, queued, move;
+
+  mask &= (1u << ncpu) - 1;
+  if(mask == 0)
+    return -1;
+  found = 0;
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->state == UNUSED || (pid ? p->pid != pid : p != curproc))
+      continue;
+    //a queued process moves to a queue it may be run from.
+    queued = p->state == RUNNABLE && unqueue(p);
+    p->cpumask = mask;
+    if(queued)
+      setrunnable(p);
+    found = 1;
+  }
+  move = !canrun(curproc, cpuid());
+  release(&ptable.lock);
+  if(!found)
+    return -1;
+  if(move)
+    yield();
+  return 0;
+}
+
+// The CPU mask of the calling thread (pid 0) or of process pid.
+int
+getaffinity(int pid)
+{
+  struct proc *p;
+  uint mask;
+
+  if(pid == 0)
+    return myproc()->cpumask & ((1u << ncpu) - 1);
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->state != UNUSED && p->pid == pid && !p->isThread){
+      mask = p->cpumask & ((1u << ncpu) - 1);
+      release(&ptable.lock);
+      return mask;
+    }
+  }
+  release(&ptable.lock);
   return -1;
 }
 
 int
 getlev(void)
 {
+#ifdef MLFQ_SCHED
+  //a boost that has not reached this process yet still counts.
+  if(myproc()->epoch != ptable.epoch)
+    return 0;
+#endif
   return myproc()->level;
 }
 
+// Give back p's stride tickets. The ptable lock must be held.
+static void
+droptickets(struct proc *p)
+{
+#ifdef MLFQ_SCHED
+  ptable.tickets -= p->tickets;
+#endif
+  p->tickets = 0;
+}
+
+// Move the caller into the stride class with a fixed share of
+// tickets out of NTICKETS, or back to MLFQ with 0 tickets.
+// Fails if stride processes would hold more than MAXTICKETS.
+int
+settickets(int tickets)
+{
+#ifdef MLFQ_SCHED
+  struct proc *p = myproc();
+
+  if(tickets < 0)
+    return -1;
+  acquire(&ptable.lock);
+  if(ptable.tickets - p->tickets + tickets > MAXTICKETS){
+    release(&ptable.lock);
+    return -1;
+  }
+  ptable.tickets += tickets - p->tickets;
+  p->tickets = tickets;
+  p->pass = ptable.vtime;
+  release(&ptable.lock);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+int
+getmlfq(struct mlfqconf *mc)
+{
+#ifdef MLFQ_SCHED
+  int lv;
+
+  acquire(&ptable.lock);
+  mc->nlevel = ptable.nlevel;
+  for(lv = 0; lv < NLEVEL; lv++)
+    mc->quantum[lv] = ptable.quantum[lv];
+  mc->boost = boostperiod;
+  mc->group = ptable.group;
+  release(&ptable.lock);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+// Replace the level count, quantum table, boost period and
+// accounting mode. Processes queued on levels that go away move
+// to the new last level, all under ptable.lock so no pick sees
+// a mix.
+int
+setmlfq(struct mlfqconf *mc)
+{
+#ifdef MLFQ_SCHED
+  struct proc *p;
+  int lv, pty, last;
+
+  if(mc->nlevel < 1 || mc->nlevel > NLEVEL || mc->boost < 0)
+    return -1;
+  if(mc->group != 0 && mc->group != 1)
+    return -1;
+  for(lv = 0; lv < mc->nlevel; lv++)
+    if(mc->quantum[lv] < 1)
+      return -1;
+
+  acquire(&ptable.lock);
+  last = mc->nlevel - 1;
+  for(lv = mc->nlevel; lv < NLEVEL; lv++){
+    if((ptable.lvmap & (1 << lv)) == 0)
+      continue;
+    for(pty = 0; pty < NPTY; pty++){
+      for(p = ptable.mlfq[lv][pty].head; p; p = p->next)
+        p->level = last;
+      rqsplice(&ptable.mlfq[last][pty], &ptable.mlfq[lv][pty]);
+    }
+    ptable.ptymap[last] |= ptable.ptymap[lv];
+    ptable.ptymap[lv] = 0;
+    ptable.lvmap = (ptable.lvmap & ~(1 << lv)) | (1 << last);
+  }
+  ptable.nlevel = mc->nlevel;
+  for(lv = 0; lv < NLEVEL; lv++)
+    ptable.quantum[lv] = lv < mc->nlevel ? mc->quantum[lv] : 0;
+  boostperiod = mc->boost;
+  if(mc->group != ptable.group){
+    // Queue the MLFQ processes again under the new mode.
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+      if(p->state == RUNNABLE && p->tickets == 0)
+        classremove(p);
+    ptable.group = mc->group;
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+      if(p->state == RUNNABLE && p->tickets == 0)
+        classpush(p);
+  }
+  release(&ptable.lock);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
 // Enter scheduler.  Must hold only ptable.lock
 // and have changed proc->state. Saves and restores
 // intena because intena is a property of this
@@ -787,6 +1988,9 @@ sched(void)
     panic("sched running");
   if(readeflags()&FL_IF)
     panic("sched interruptible");
+  //killAll() may be waiting for p to leave the CPU.
+  if(p->vm && p->vm->reaper && p->vm->reaper != p)
+    wakeup1(&p->vm->reaper);
   intena = mycpu()->intena;
   swtch(&p->context, mycpu()->scheduler);
   mycpu()->intena = intena;
@@ -798,6 +2002,7 @@ yield(void)
 {
   acquire(&ptable.lock);  //DOC: yieldlock
   myproc()->state = RUNNABLE;
+  myproc()->readyat = ticks;
   sched();
   release(&ptable.lock);
 }
@@ -849,6 +2054,8 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->nvcsw++;
+  rqpush(sleepq(chan), p);
 
   sched();
 
@@ -868,11 +2075,16 @@ sleep(void *chan, struct spinlock *lk)
 static void
 wakeup1(void *chan)
 {
-  struct proc *p;
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
-      p->state = RUNNABLE;
+  struct runq *q = sleepq(chan);
+  struct proc *p, *next;
+
+  for(p = q->head; p; p = next){
+    next = p->next;
+    if(p->chan == chan){
+      rqremove(q, p);
+      setrunnable(p);
+    }
+  }
 }
 
 // Wake up all processes sleeping on chan.
@@ -884,6 +2096,86 @@ wakeup(void *chan)
   release(&ptable.lock);
 }
 
+// Wake up to n of the processes sleeping on chan, longest
+// sleeper first. Returns how many woke.
+// The ptable lock must be held.
+static int
+wakeupn1(void *chan, int n)
+{
+  struct runq *q = sleepq(chan);
+  struct proc *p, *next;
+  int woken = 0;
+
+  for(p = q->head; p && woken < n; p = next){
+    next = p->next;
+    if(p->chan == chan){
+      rqremove(q, p);
+      setrunnable(p);
+      woken++;
+    }
+  }
+  return woken;
+}
+
+// Wake up the process that has slept longest on chan.
+// For waiters that each consume what they wait for: the one
+// woken passes the wakeup on if something is left over.
+void
+wakeupone(void *chan)
+{
+  acquire(&ptable.lock);
+  wakeupn1(chan, 1);
+  release(&ptable.lock);
+}
+
+// A futex is named by the kernel address of the user word, so
+// every thread sharing the page table finds the same sleepers.
+// argptr() has faulted the word in; 0 if it is gone again.
+static void*
+futexkey(uint uaddr)
+{
+  char *ka;
+
+  if((ka = uva2ka(myproc()->vm->pgdir, (char*)uaddr)) == 0)
+    return 0;
+  return ka + (uaddr & (PGSIZE-1));
+}
+
+// Sleep on the word at uaddr if it still holds expected.
+// Returns 0 when woken, -1 if the value differed or on error.
+int
+futexwait(uint uaddr, int expected)
+{
+  void *key;
+  int r = -1;
+
+  acquire(&ptable.lock);
+  //checked under ptable.lock, so a futexwake after the
+  //caller's store cannot slip in before we sleep.
+  if((key = futexkey(uaddr)) != 0 && *(int*)key == expected &&
+     !myproc()->killed){
+    sleep(key, &ptable.lock);
+    r = 0;
+  }
+  release(&ptable.lock);
+  return r;
+}
+
+// Wake up to n threads sleeping on the word at uaddr.
+// Returns how many woke.
+int
+futexwake(uint uaddr, int n)
+{
+  void *key;
+  int woken = 0;
+
+  acquire(&ptable.lock);
+  if((key = futexkey(uaddr)) != 0)
+    woken = wakeupn1(key, n);
+  release(&ptable.lock);
+  return woken;
+}
+
 // Kill the process with the given pid.
 // Process won't exit until it returns
 // to user space (see trap in trap.c).
@@ -898,8 +2190,10 @@ kill(int pid)
     if(p->pid == pid){
       p->killed = 1;
       // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-        p->state = RUNNABLE;
+      if(p->state == SLEEPING){
+        rqremove(sleepq(p->chan), p);
+        setrunnable(p);
+      }
       release(&ptable.lock);
       return 0;
     }
@@ -908,6 +2202,63 @@ kill(int pid)
   return -1;
 }
 
+// Copy the idle counters of up to n CPUs into cs.
+// Returns the number of CPUs.
+int
+getcpustat(struct cpustat *cs, int n)
+{
+  int i;
+
+  for(i = 0; i < n && i < ncpu; i++){
+    cs[i].ticks = cpus[i].ticks;
+    cs[i].idleticks = cpus[i].idleticks;
+    cs[i].halts = cpus[i].halts;
+    kcachestat(i, &cs[i]);
+  }
+  return ncpu;
+}
+
+// Copy the statistics of up to n processes and threads into ps.
+// Returns the number copied.
+int
+getpinfo(struct pstat *ps, int n)
+{
+  struct proc *p;
+  int i = 0;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC] && i < n; p++){
+    if(p->state == UNUSED)
+      continue;
+    ps[i].pid = p->pid;
+    ps[i].tid = p->tid;
+    ps[i].state = p->state;
+    safestrcpy(ps[i].name, p->name, sizeof(ps[i].name));
+    ps[i].level = p->level;
+#ifdef MLFQ_SCHED
+    if(p->epoch != ptable.epoch)
+      ps[i].level = 0;
+#endif
+    ps[i].pty = p->pty;
+    ps[i].tickets = p->tickets;
+    ps[i].utime = p->utime;
+    ps[i].stime = p->stime;
+    ps[i].nvcsw = p->nvcsw;
+    ps[i].nivcsw = p->nivcsw;
+    ps[i].waitticks = p->waitticks;
+    ps[i].maxwait = p->maxwait;
+    memmove(ps[i].lvticks, p->lvticks, sizeof(ps[i].lvticks));
+    ps[i].sz = p->vm ? p->vm->sz : 0;
+    ps[i].nfault = p->vm ? p->vm->nfault : 0;
+    ps[i].nload = p->vm ? p->vm->nload : 0;
+    ps[i].resident = p->vm && p->vm->pgdir ?
+                     uvmresident(p->vm->pgdir, p->vm->sz) : 0;
+    i++;
+  }
+  release(&ptable.lock);
+  return i;
+}
+
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
@@ -935,7 +2286,8 @@ procdump(void)
       state = states[p->state];
     else
       state = "???";
-    cprintf("%d %s %s", p->pid, state, p->name);
+    cprintf("%d %s %s u%d s%d w%d", p->pid, state, p->name,
+            p->utime, p->stime, p->waitticks);
     if(p->state == SLEEPING){
       getcallerpcs((uint*)p->context->ebp+2, pc);
       for(i=0; i<10 && pc[i] != 0; i++)
@@ -9,6 +9,10 @@ struct cpu {
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
   struct thread_t * thread;    // The thread running on this cpu
+  volatile uint idle;          // Halted in the scheduler's idle loop?
+  uint ticks;                  // Timer interrupts taken
+  uint idleticks;              // Timer interrupts that found the cpu idle
+  uint halts;                  // Times the idle loop halted
 };
 
 extern struct cpu cpus[NCPU];
@@ -35,10 +39,53 @@ struct context {
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A deadline on the timer wheel, see timer.c.
+struct timer {
+  uint expires;                // Tick to fire at
+  void *chan;                  // wakeup() channel when it fires
+  struct timer *next;          // Next timer in the slot
+  struct timer *prev;          // Previous timer in the slot
+  struct timer **slot;         // Slot it is filed in, 0 if not pending
+};
+
+// A FIFO of RUNNABLE processes linked through proc->next and proc->prev.
+struct runq {
+  struct proc *head;
+  struct proc *tail;
+};
+
+// Part of the executable that lazyfault() reads in on first touch.
+struct vmseg {
+  uint va;                     // Start, page aligned
+  uint memsz;                  // Bytes in memory
+  uint off;                    // Offset in the executable
+  uint filesz;                 // Bytes read from it; the rest is zero
+};
+
+// Address space shared by the threads of a process.
+struct vmspace {
+  pde_t* pgdir;                // Page table
+  uint sz;                     // Size of process memory (bytes)
+  int ref;                     // Threads using it, 0 if free
+  struct proc *main;           // Main thread
+  uint freestack[NPROC];       // Stacks of joined threads, for reuse
+  int nfreestack;              // Entries in freestack
+  struct proc *onq;            // Thread holding the group's MLFQ place
+  struct runq ready;           // Other runnable threads, in group mode
+  struct runq zombies;         // Exited threads to join, oldest first
+  int njoinable;               // Threads not yet joined or detached
+  int anyjoin;                 // Threads sleeping in thread_join_any()
+  struct proc *reaper;         // Thread freeing the others in killAll()
+  uint nfault;                 // Pages faulted in by lazyfault()
+  uint nload;                  // Of those, pages read from ip
+  struct inode *ip;            // Executable, 0 if nothing is left to read
+  struct vmseg seg[NVMSEG];    // Its segments not loaded by exec()
+  int nseg;                    // Entries in seg
+};
+
 // Per-process state
 struct proc {
-  uint sz;                     // Size of process memory (bytes)
-  pde_t* pgdir;                // Page table
+  struct vmspace *vm;          // Address space
   char *kstack;                // Bottom of kernel stack for this process
   enum procstate state;        // Process state
   int pid;                     // Process ID
@@ -47,20 +94,38 @@ struct proc {
   struct context *context;     // swtch() here to run process
   void *chan;                  // If non-zero, sleeping on chan
   int killed;                  // If non-zero, have been killed
-  struct file *ofile[NOFILE];  // Open files
+  struct fdtable *fdt;         // Open files, shared by the threads
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
   struct proc * next;          // Next Process in queue
+  struct proc * prev;          // Previous Process in queue
+  int cpu;                     // CPU this process last ran on
+  uint cpumask;                // CPUs it may run on, a bit each
   int pty;		                 // process priority
   int level;		               // queue level
   int ticks;                   // time quantum
-  int time;                    // real time
+  uint epoch;                  // boost epoch level and ticks belong to
+  int tickets;                 // stride tickets, 0 if scheduled by MLFQ
+  uint pass;                   // stride pass value
+  int stridx;                  // index in the stride heap
+  uint utime;                  // Timer ticks taken in user mode
+  uint stime;                  // Timer ticks taken in the kernel
+  uint nvcsw;                  // Voluntary context switches
+  uint nivcsw;                 // Involuntary context switches
+  uint readyat;                // ticks when last made RUNNABLE
+  uint waitticks;              // Ticks spent RUNNABLE before dispatch
+  uint maxwait;                // Longest single wait for a CPU
+  uint lvticks[NLEVEL];        // Ticks taken at each MLFQ level
+  struct timer timer;          // Wakes sleepers in sleepuntil()
   //for thread:
   struct proc *creator;        // proc or thread that create this thread
   int isThread;                // 0 - process, 1 - thread
   int nextTid;                 // only hold by main thread
   thread_t tid;                // -1 - process, 0~ - thread
+  uint ustack;                 // Bottom of the thread's stack and guard page
+  uint tls;                    // Base of the %gs segment
   void *retval;                // for thread_join
+  int detached;                // reaped by the kernel when it exits
 };
 
 typedef int thread_t;
@@ -0,0 +1,43 @@
+// Scheduler and page allocator statistics returned by getcpustat().
+struct cpustat {
+  uint ticks;      // Timer interrupts taken
+  uint idleticks;  // Timer interrupts that found the cpu idle
+  uint halts;      // Times the idle loop halted
+  uint nalloc;     // Pages handed out by kalloc()
+  uint nrefill;    // Batches of free pages taken from the pool
+  uint ndrain;     // Batches of free pages given back to the pool
+  uint nsteal;     // Pages taken from other CPUs' caches
+  uint nfree;      // Free pages in this CPU's cache
+};
+
+// Utilisation of one kmalloc() size class, from getslabstat().
+struct slabstat {
+  uint size;       // Object size
+  uint nslab;      // Pages held
+  uint total;      // Objects the pages hold
+  uint inuse;      // Objects allocated
+  uint cached;     // Free objects in CPU magazines
+  uint nalloc;     // kmalloc() calls served
+};
+
+// Per-process statistics returned by getpinfo().
+struct pstat {
+  int pid;
+  int tid;               // -1 for a process, else its thread id
+  int state;             // enum procstate
+  char name[16];
+  int level;             // Current MLFQ level
+  int pty;
+  int tickets;           // Stride tickets, 0 under MLFQ
+  uint utime;            // Timer ticks taken in user mode
+  uint stime;            // Timer ticks taken in the kernel
+  uint nvcsw;            // Voluntary context switches
+  uint nivcsw;           // Involuntary context switches
+  uint waitticks;        // Ticks spent RUNNABLE before dispatch
+  uint maxwait;          // Longest single wait for a CPU
+  uint lvticks[NLEVEL];  // Ticks taken at each MLFQ level
+  uint sz;               // Size of process memory (bytes)
+  uint nfault;           // Pages faulted in on first touch
+  uint nload;            // Of those, pages read from the program file
+  uint resident;         // Pages below sz that are mapped
+};
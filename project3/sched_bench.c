@@ -0,0 +1,64 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define MAX_CHILD 8
+#define NUM_WORK 20000000
+
+// CPU-bound children, 1 to MAX_CHILD at a time.
+// Boot with CPUS=8 to see how throughput scales with the cores;
+// with fewer CPUs it levels off at the CPU count.
+
+void spin(void)
+{
+  volatile int i;
+
+  for (i = 0; i < NUM_WORK; i++)
+    ;
+}
+
+// Returns the ticks it took n children to finish one unit of work each.
+int run(int n)
+{
+  int i, p, start;
+
+  start = uptime();
+  for (i = 0; i < n; i++)
+  {
+    if ((p = fork()) < 0)
+    {
+      printf(1, "fork failed\n");
+      exit();
+    }
+    if (p == 0)
+    {
+      spin();
+      exit();
+    }
+  }
+  for (i = 0; i < n; i++)
+    wait();
+  return uptime() - start;
+}
+
+int main(int argc, char *argv[])
+{
+  int n, elapsed, base, speedup;
+
+  printf(1, "sched bench start\n");
+  base = 0;
+  for (n = 1; n <= MAX_CHILD; n++)
+  {
+    elapsed = run(n);
+    if (elapsed == 0)
+      elapsed = 1;
+    // throughput relative to one child, in hundredths
+    if (base == 0)
+      base = elapsed;
+    speedup = n * base * 100 / elapsed;
+    printf(1, "%d children: %d ticks, speedup %d.%d%d\n", n, elapsed,
+           speedup / 100, speedup / 10 % 10, speedup % 10);
+  }
+  printf(1, "sched bench finished\n");
+  exit();
+}
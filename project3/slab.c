@@ -0,0 +1,239 @@
+// Kernel object allocator for structures smaller than a page.
+// Objects come in power-of-two size classes. Each class carves
+// whole pages from kalloc() into slabs of equal objects, and
+// keeps a magazine of free objects for every CPU, so most
+// kmalloc() and kmfree() calls touch no lock at all.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "pstat.h"
+
+#define KMMIN 32       // smallest size class
+#define KMMAX 1024     // largest size class, NKMCACHE up from KMMIN
+#define KMMAG 16       // objects a CPU keeps in its magazine
+
+struct kmobj {
+  struct kmobj *next;
+};
+
+// Head of every slab page, so kmfree() can find the cache
+// of an object from its address alone.
+struct slab {
+  struct kmcache *cache;
+  struct slab *next;           // on the cache's partial list
+  struct slab *prev;
+  struct kmobj *free;          // free objects in this slab
+  uint inuse;                  // objects not on free
+};
+
+#define SLABHDR ((sizeof(struct slab) + 7) & ~7)
+
+// Free objects a CPU hands out before going to the slabs.
+// Only touched by its own CPU with interrupts off.
+struct kmmag {
+  int n;
+  uint nalloc;                 // kmalloc() calls served on this CPU
+  void *obj[KMMAG];
+};
+
+struct kmcache {
+  struct spinlock lock;        // protects the slabs and counters
+  uint size;                   // object size
+  uint perslab;                // objects in one slab
+  struct slab *partial;        // slabs with free objects
+  uint nslab;                  // pages held
+  uint out;                    // objects taken out of slabs
+  struct kmmag mag[NCPU];
+} kmcache[NKMCACHE];
+
+void
+kminit(void)
+{
+  struct kmcache *c;
+  uint size;
+
+  size = KMMIN;
+  for(c = kmcache; c < &kmcache[NKMCACHE]; c++){
+    initlock(&c->lock, "kmcache");
+    c->size = size;
+    c->perslab = (PGSIZE - SLABHDR) / size;
+    size *= 2;
+  }
+}
+
+// Cache serving objects of n bytes.
+static struct kmcache*
+kmcachefor(uint n)
+{
+  struct kmcache *c;
+
+  if(n == 0 || n > KMMAX)
+    panic("kmalloc: size");
+  for(c = kmcache; c->size < n; c++)
+    ;
+  return c;
+}
+
+static void
+partialpush(struct kmcache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(c->partial)
+    c->partial->prev = s;
+  c->partial = s;
+}
+
+static void
+partialremove(struct kmcache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// Carve a fresh page into objects. c->lock must be held.
+static struct slab*
+newslab(struct kmcache *c)
+{
+  struct slab *s;
+  char *o;
+  uint i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->free = 0;
+  s->inuse = 0;
+  o = (char*)s + SLABHDR;
+  for(i = 0; i < c->perslab; i++, o += c->size){
+    ((struct kmobj*)o)->next = s->free;
+    s->free = (struct kmobj*)o;
+  }
+  partialpush(c, s);
+  c->nslab++;
+  return s;
+}
+
+// Fill half of magazine m from the slabs of c.
+static void
+refill(struct kmcache *c, struct kmmag *m)
+{
+  struct slab *s;
+  struct kmobj *o;
+
+  acquire(&c->lock);
+  while(m->n < KMMAG/2){
+    if((s = c->partial) == 0 && (s = newslab(c)) == 0)
+      break;
+    o = s->free;
+    s->free = o->next;
+    s->inuse++;
+    if(s->free == 0)
+      partialremove(c, s);
+    m->obj[m->n++] = o;
+    c->out++;
+  }
+  release(&c->lock);
+}
+
+// Put half of magazine m back into the slabs of c. A slab left
+// empty goes back to kalloc() unless it is the only one with room.
+static void
+flush(struct kmcache *c, struct kmmag *m)
+{
+  struct slab *s;
+  struct kmobj *o;
+
+  acquire(&c->lock);
+  while(m->n > KMMAG/2){
+    o = m->obj[--m->n];
+    s = (struct slab*)PGROUNDDOWN((uint)o);
+    if(s->free == 0)
+      partialpush(c, s);
+    o->next = s->free;
+    s->free = o;
+    c->out--;
+    if(--s->inuse == 0 && (s->prev || s->next)){
+      partialremove(c, s);
+      c->nslab--;
+      kfree((char*)s);
+    }
+  }
+  release(&c->lock);
+}
+
+// Allocate n bytes, at most KMMAX. Returns 0 if out of memory.
+void*
+kmalloc(uint n)
+{
+  struct kmcache *c;
+  struct kmmag *m;
+  void *p;
+
+  c = kmcachefor(n);
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == 0)
+    refill(c, m);
+  p = 0;
+  if(m->n > 0){
+    p = m->obj[--m->n];
+    m->nalloc++;
+  }
+  popcli();
+  return p;
+}
+
+// Free an object returned by kmalloc().
+void
+kmfree(void *p)
+{
+  struct slab *s;
+  struct kmcache *c;
+  struct kmmag *m;
+
+  s = (struct slab*)PGROUNDDOWN((uint)p);
+  c = s->cache;
+  if(c < kmcache || c >= &kmcache[NKMCACHE] || (char*)p < (char*)s + SLABHDR)
+    panic("kmfree");
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == KMMAG)
+    flush(c, m);
+  m->obj[m->n++] = p;
+  popcli();
+}
+
+// Copy the utilisation of up to n size classes into ss.
+// Magazines are counted without their CPUs' help, so the
+// numbers are only a snapshot. Returns the number of classes.
+int
+getslabstat(struct slabstat *ss, int n)
+{
+  struct kmcache *c;
+  int i, j;
+
+  for(i = 0; i < n && i < NKMCACHE; i++){
+    c = &kmcache[i];
+    acquire(&c->lock);
+    ss[i].size = c->size;
+    ss[i].nslab = c->nslab;
+    ss[i].total = c->nslab * c->perslab;
+    ss[i].cached = ss[i].nalloc = 0;
+    for(j = 0; j < NCPU; j++){
+      ss[i].cached += c->mag[j].n;
+      ss[i].nalloc += c->mag[j].nalloc;
+    }
+    ss[i].inuse = c->out - ss[i].cached;
+    release(&c->lock);
+  }
+  return NKMCACHE;
+}
@@ -0,0 +1,33 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "pstat.h"
+
+#define NCLASS 16
+
+// Print how full the kernel's kmalloc() size classes are.
+// usage: slabstat
+// USE is allocated objects out of what the pages hold, CACHED
+// free objects held in CPU magazines, UTIL the share of the
+// pages' bytes handed out.
+
+int main(int argc, char *argv[])
+{
+  struct slabstat ss[NCLASS];
+  int i, n, util;
+
+  n = getslabstat(ss, NCLASS);
+  if (n > NCLASS)
+    n = NCLASS;
+  printf(1, "SIZE PAGES USE CACHED UTIL ALLOCS\n");
+  for (i = 0; i < n; i++)
+  {
+    util = 0;
+    if (ss[i].nslab)
+      util = ss[i].inuse * ss[i].size * 100 / (ss[i].nslab * 4096);
+    printf(1, "%d %d %d/%d %d %d%% %d\n", ss[i].size, ss[i].nslab,
+           ss[i].inuse, ss[i].total, ss[i].cached, util, ss[i].nalloc);
+  }
+  exit();
+}
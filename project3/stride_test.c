@@ -0,0 +1,135 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NUM_STRIDE 3
+#define NUM_HOG 2
+#define NUM_CHILD (NUM_STRIDE + NUM_HOG)
+#define RUN_TICKS 500
+#define TOLERANCE 20 // percent
+
+// Stride processes hold fixed shares while MLFQ hogs soak up
+// the rest, so every CPU stays busy. Each child counts loop
+// iterations for RUN_TICKS; the counts of the stride processes
+// divided by their tickets should come out equal.
+// Needs a kernel built with SCHED_POLICY=MLFQ_SCHED.
+
+int tickets[NUM_STRIDE] = {5, 10, 20};
+
+// Spin until end, counting iterations.
+int work(int end)
+{
+  volatile int i;
+  int n;
+
+  n = 0;
+  while (uptime() < end)
+  {
+    for (i = 0; i < 1000; i++)
+      ;
+    n++;
+  }
+  return n;
+}
+
+// Report {id, count} to the parent; count -1 on failure.
+void child(int fd, int id, int start)
+{
+  int msg[2];
+
+  msg[0] = id;
+  msg[1] = -1;
+  if (id < NUM_STRIDE && settickets(tickets[id]) < 0)
+  {
+    printf(1, "settickets(%d) failed\n", tickets[id]);
+    write(fd, msg, sizeof(msg));
+    exit();
+  }
+  while (uptime() < start)
+    ;
+  msg[1] = work(start + RUN_TICKS);
+  write(fd, msg, sizeof(msg));
+  exit();
+}
+
+int main(int argc, char *argv[])
+{
+  int fd[2], msg[2], count[NUM_CHILD];
+  int i, p, start, total, mean, norm, failed;
+
+  printf(1, "stride test start\n");
+
+  if (settickets(81) == 0)
+  {
+    printf(1, "settickets above the limit succeeded\n");
+    exit();
+  }
+
+  if (pipe(fd) < 0)
+  {
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  start = uptime() + 20;
+  for (i = 0; i < NUM_CHILD; i++)
+  {
+    if ((p = fork()) < 0)
+    {
+      printf(1, "fork failed\n");
+      exit();
+    }
+    if (p == 0)
+    {
+      close(fd[0]);
+      child(fd[1], i, start);
+    }
+  }
+  close(fd[1]);
+  for (i = 0; i < NUM_CHILD; i++)
+  {
+    if (read(fd[0], msg, sizeof(msg)) != sizeof(msg) || msg[1] < 0)
+    {
+      printf(1, "child failed\n");
+      exit();
+    }
+    count[msg[0]] = msg[1];
+  }
+  close(fd[0]);
+  for (i = 0; i < NUM_CHILD; i++)
+    wait();
+
+  total = 0;
+  for (i = 0; i < NUM_CHILD; i++)
+    total += count[i];
+  if (total == 0)
+    total = 1;
+  mean = 0;
+  for (i = 0; i < NUM_STRIDE; i++)
+    mean += count[i] / tickets[i];
+  mean /= NUM_STRIDE;
+  if (mean == 0)
+    mean = 1;
+
+  failed = 0;
+  for (i = 0; i < NUM_CHILD; i++)
+  {
+    if (i < NUM_STRIDE)
+    {
+      // work per ticket relative to the mean, in percent
+      norm = count[i] / tickets[i] * 100 / mean;
+      printf(1, "stride %d tickets: %d%% of work, %d%% of fair\n",
+             tickets[i], count[i] * 100 / total, norm);
+      if (norm < 100 - TOLERANCE || norm > 100 + TOLERANCE)
+        failed = 1;
+    }
+    else
+      printf(1, "mlfq hog: %d%% of work\n",
+             count[i] * 100 / total);
+  }
+  if (failed)
+    printf(1, "stride test failed: shares off by more than %d%%\n",
+           TOLERANCE);
+  else
+    printf(1, "stride test finished\n");
+  exit();
+}
@@ -12,6 +12,8 @@
 // Arguments on the stack, from the user call to the C
 // library system call function. The saved user %esp points
 // to a saved program counter, and then the first argument.
+// The fetch functions fault in the user pages they check, so the
+// kernel may use them later without faulting under a spinlock.
 
 // Fetch the int at addr from the current process.
 int
@@ -19,7 +21,9 @@ fetchint(uint addr, int *ip)
 {
   struct proc *curproc = myproc();
 
-  if(addr >= curproc->sz || addr+4 > curproc->sz)
+  if(addr >= curproc->vm->sz || addr+4 > curproc->vm->sz)
+    return -1;
+  if(uvmtouch(curproc->vm, addr, 4) < 0)
     return -1;
   *ip = *(int*)(addr);
   return 0;
@@ -34,11 +38,14 @@ fetchstr(uint addr, char **pp)
   char *s, *ep;
   struct proc *curproc = myproc();
 
-  if(addr >= curproc->sz)
+  if(addr >= curproc->vm->sz)
     return -1;
   *pp = (char*)addr;
-  ep = (char*)curproc->sz;
+  ep = (char*)curproc->vm->sz;
   for(s = *pp; s < ep; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) &&
+       uvmtouch(curproc->vm, (uint)s, 1) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -63,7 +70,9 @@ argptr(int n, char **pp, int size)
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  if(size < 0 || (uint)i >= curproc->vm->sz || (uint)i+size > curproc->vm->sz)
+    return -1;
+  if(uvmtouch(curproc->vm, i, size) < 0)
     return -1;
   *pp = (char*)i;
   return 0;
@@ -111,6 +120,23 @@ extern int sys_getlev(void);
 extern int sys_thread_create(void);
 extern int sys_thread_exit(void);
 extern int sys_thread_join(void);
+extern int sys_getcpustat(void);
+extern int sys_getmlfq(void);
+extern int sys_setmlfq(void);
+extern int sys_settickets(void);
+extern int sys_getpinfo(void);
+extern int sys_nanosleep(void);
+extern int sys_futex_wait(void);
+extern int sys_futex_wake(void);
+extern int sys_settls(void);
+extern int sys_thread_join_any(void);
+extern int sys_thread_detach(void);
+extern int sys_setaffinity(void);
+extern int sys_getaffinity(void);
+extern int sys_getcpu(void);
+extern int sys_thread_create_many(void);
+extern int sys_freemem(void);
+extern int sys_getslabstat(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -142,6 +168,23 @@ static int (*syscalls[])(void) = {
 [SYS_thread_create] sys_thread_create,
 [SYS_thread_exit] sys_thread_exit,
 [SYS_thread_join] sys_thread_join,
+[SYS_getcpustat] sys_getcpustat,
+[SYS_getmlfq] sys_getmlfq,
+[SYS_setmlfq] sys_setmlfq,
+[SYS_settickets] sys_settickets,
+[SYS_getpinfo] sys_getpinfo,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_settls] sys_settls,
+[SYS_thread_join_any] sys_thread_join_any,
+[SYS_thread_detach] sys_thread_detach,
+[SYS_setaffinity] sys_setaffinity,
+[SYS_getaffinity] sys_getaffinity,
+[SYS_getcpu] sys_getcpu,
+[SYS_thread_create_many] sys_thread_create_many,
+[SYS_freemem] sys_freemem,
+[SYS_getslabstat] sys_getslabstat,
 };
 
 void
@@ -28,3 +28,20 @@
 #define SYS_thread_create 27
 #define SYS_thread_exit 28
 #define SYS_thread_join 29
+#define SYS_getcpustat 30
+#define SYS_getmlfq 31
+#define SYS_setmlfq 32
+#define SYS_settickets 33
+#define SYS_getpinfo 34
+#define SYS_nanosleep 35
+#define SYS_futex_wait 36
+#define SYS_futex_wake 37
+#define SYS_settls 38
+#define SYS_thread_join_any 39
+#define SYS_thread_detach 40
+#define SYS_setaffinity 41
+#define SYS_getaffinity 42
+#define SYS_getcpu 43
+#define SYS_thread_create_many 44
+#define SYS_freemem 45
+#define SYS_getslabstat 46
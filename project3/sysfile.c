@@ -18,20 +18,30 @@
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
+// The file comes with a reference of its own, so another thread
+// closing the descriptor cannot free it; the caller must
+// fileclose() it when done.
 static int
 argfd(int n, int *pfd, struct file **pf)
 {
   int fd;
   struct file *f;
+  struct fdtable *fdt = myproc()->fdt;
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(fd < 0 || fd >= NOFILE)
     return -1;
+  acquire(&fdt->lock);
+  if((f=fdt->ofile[fd]) == 0){
+    release(&fdt->lock);
+    return -1;
+  }
+  filedup(f);
+  release(&fdt->lock);
   if(pfd)
     *pfd = fd;
-  if(pf)
-    *pf = f;
+  *pf = f;
   return 0;
 }
 
@@ -41,14 +51,17 @@ static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *curproc = myproc();
+  struct fdtable *fdt = myproc()->fdt;
 
+  acquire(&fdt->lock);
   for(fd = 0; fd < NOFILE; fd++){
-    if(curproc->ofile[fd] == 0){
-      curproc->ofile[fd] = f;
+    if(fdt->ofile[fd] == 0){
+      fdt->ofile[fd] = f;
+      release(&fdt->lock);
       return fd;
     }
   }
+  release(&fdt->lock);
   return -1;
 }
 
@@ -61,8 +74,7 @@ sys_dup(void)
   if(argfd(0, 0, &f) < 0)
     return -1;
   if((fd=fdalloc(f)) < 0)
-    return -1;
-  filedup(f);
+    fileclose(f);
   return fd;
 }
 
@@ -70,24 +82,32 @@ int
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = -1;
+  if(argint(2, &n) >= 0 && argptr(1, &p, n) >= 0)
+    r = fileread(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 int
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0)
     return -1;
-  return filewrite(f, p, n);
+  r = -1;
+  if(argint(2, &n) >= 0 && argptr(1, &p, n) >= 0)
+    r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 int
@@ -95,10 +115,22 @@ sys_close(void)
 {
   int fd;
   struct file *f;
+  struct fdtable *fdt = myproc()->fdt;
 
   if(argfd(0, &fd, &f) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;
+  //another thread may have closed it first.
+  acquire(&fdt->lock);
+  if(fdt->ofile[fd] != f){
+    release(&fdt->lock);
+    fileclose(f);
+    return -1;
+  }
+  fdt->ofile[fd] = 0;
+  release(&fdt->lock);
+  // Drop the table's reference and argfd's. A thread still
+  // blocked in read() or write() on f keeps it open.
+  fileclose(f);
   fileclose(f);
   return 0;
 }
@@ -108,10 +140,15 @@ sys_fstat(void)
 {
   struct file *f;
   struct stat *st;
+  int r;
 
-  if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+  if(argfd(0, 0, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = -1;
+  if(argptr(1, (void*)&st, sizeof(*st)) >= 0)
+    r = filestat(f, st);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -432,8 +469,11 @@ sys_pipe(void)
     return -1;
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
-    if(fd0 >= 0)
-      myproc()->ofile[fd0] = 0;
+    if(fd0 >= 0){
+      acquire(&myproc()->fdt->lock);
+      myproc()->fdt->ofile[fd0] = 0;
+      release(&myproc()->fdt->lock);
+    }
     fileclose(rf);
     fileclose(wf);
     return -1;
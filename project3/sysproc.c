@@ -6,6 +6,8 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "pstat.h"
+#include "mlfq.h"
 
 int
 sys_fork(void)
@@ -49,7 +51,7 @@ sys_sbrk(void)
 
   if(argint(0, &n) < 0)
     return -1;
-  addr = myproc()->sz;
+  addr = myproc()->vm->sz;
   if(growproc(n) < 0)
     return -1;
   return addr;
@@ -65,13 +67,9 @@ sys_sleep(void)
     return -1;
   acquire(&tickslock);
   ticks0 = ticks;
-
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
+  if(sleepuntil(ticks0 + n) < 0){
+    release(&tickslock);
+    return -1;
   }
   release(&tickslock);
   myproc()->ticks = 0;
@@ -81,6 +79,68 @@ sys_sleep(void)
 
 // return how many clock tick interrupts have occurred
 // since start.
+// Whole ticks are slept on the timer wheel, the remainder
+// spun on the lapic timer with interrupts on.
+int
+sys_nanosleep(void)
+{
+  int sec, nsec;
+
+  if(argint(0, &sec) < 0 || argint(1, &nsec) < 0)
+    return -1;
+  if(sec < 0 || nsec < 0 || nsec >= 1000000000)
+    return -1;
+  //the deadline must stay less than 2^31 ticks away.
+  if(sec >= 0x7fffffff / (1000000000/TICKNS))
+    return -1;
+  acquire(&tickslock);
+  if(sleepuntil(ticks + sec*(1000000000/TICKNS) + nsec/TICKNS) < 0){
+    release(&tickslock);
+    return -1;
+  }
+  release(&tickslock);
+  lapicspin(nsec % TICKNS);
+  return 0;
+}
+
+int
+sys_futex_wait(void)
+{
+  int *addr, expected;
+
+  if(argptr(0, (char**)&addr, sizeof(*addr)) < 0 || argint(1, &expected) < 0)
+    return -1;
+  if((uint)addr % sizeof(*addr))
+    return -1;
+  return futexwait((uint)addr, expected);
+}
+
+int
+sys_futex_wake(void)
+{
+  int *addr, n;
+
+  if(argptr(0, (char**)&addr, sizeof(*addr)) < 0 || argint(1, &n) < 0)
+    return -1;
+  if((uint)addr % sizeof(*addr) || n < 0)
+    return -1;
+  return futexwake((uint)addr, n);
+}
+
+// Move this thread's %gs segment to a block of its own; the
+// block's first word should hold its address.
+int
+sys_settls(void)
+{
+  char *base;
+
+  if(argptr(0, &base, sizeof(uint)) < 0)
+    return -1;
+  myproc()->tls = (uint)base;
+  switchuvm(myproc());
+  return 0;
+}
+
 int
 sys_uptime(void)
 {
@@ -98,6 +158,7 @@ sys_yield(void)
   if(myproc()->state == RUNNING){
     myproc()->ticks = 0;
     myproc()->level = 0;
+    myproc()->nvcsw++;
 
   	yield();
   }
@@ -126,6 +187,68 @@ sys_getlev(void){
   return getlev();
 }
 
+int
+sys_setaffinity(void)
+{
+  int pid, mask;
+
+  if(argint(0, &pid) < 0 || argint(1, &mask) < 0 || pid < 0)
+    return -1;
+  return setaffinity(pid, mask);
+}
+
+int
+sys_getaffinity(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0 || pid < 0)
+    return -1;
+  return getaffinity(pid);
+}
+
+// The CPU the caller is running on, as of the call.
+int
+sys_getcpu(void)
+{
+  int id;
+
+  pushcli();
+  id = cpuid();
+  popcli();
+  return id;
+}
+
+int
+sys_getmlfq(void)
+{
+  struct mlfqconf *mc;
+
+  if(argptr(0, (char**)&mc, sizeof(*mc)) < 0)
+    return -1;
+  return getmlfq(mc);
+}
+
+int
+sys_setmlfq(void)
+{
+  struct mlfqconf *mc;
+
+  if(argptr(0, (char**)&mc, sizeof(*mc)) < 0)
+    return -1;
+  return setmlfq(mc);
+}
+
+int
+sys_settickets(void)
+{
+  int tickets;
+
+  if(argint(0, &tickets) < 0)
+    return -1;
+  return settickets(tickets);
+}
+
 int
 sys_thread_create(void)
 {
@@ -158,4 +281,94 @@ sys_thread_join(void)
   argptr(1,(char**)&retval, sizeof(retval));
   return thread_join(thread, retval);
 
-}
\ No newline at end of file
+}
+
+int
+sys_thread_create_many(void)
+{
+  thread_t *thread;
+  int n;
+  void *(*start_routine)(void *);
+  void **arg;
+
+  if(argint(1, &n) < 0 || n < 1 || n > NPROC)
+    return -1;
+  if(argptr(0, (char**)&thread, n*sizeof(*thread)) < 0 ||
+     argint(2, (int*)&start_routine) < 0 ||
+     argptr(3, (char**)&arg, n*sizeof(*arg)) < 0)
+    return -1;
+  return thread_create_many(thread, n, start_routine, arg);
+}
+
+// Pages of physical memory not in use.
+int
+sys_freemem(void)
+{
+  return kfreepages();
+}
+
+int
+sys_thread_join_any(void)
+{
+  void **retval;
+
+  if(argptr(0, (char**)&retval, sizeof(*retval)) < 0)
+    return -1;
+  return thread_join_any(retval);
+}
+
+int
+sys_thread_detach(void)
+{
+  thread_t thread;
+
+  if(argint(0, &thread) < 0)
+    return -1;
+  return thread_detach(thread);
+}
+
+int
+sys_getcpustat(void)
+{
+  struct cpustat *cs;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NCPU)
+    n = NCPU;
+  if(argptr(0, (char**)&cs, n*sizeof(*cs)) < 0)
+    return -1;
+  return getcpustat(cs, n);
+}
+
+int
+sys_getslabstat(void)
+{
+  struct slabstat *ss;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NKMCACHE)
+    n = NKMCACHE;
+  if(argptr(0, (char**)&ss, n*sizeof(*ss)) < 0)
+    return -1;
+  return getslabstat(ss, n);
+}
+
+int
+sys_getpinfo(void)
+{
+  struct pstat *ps;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  //getpinfo() never fills more, and a larger n could overflow.
+  if(n > NPROC)
+    n = NPROC;
+  if(argptr(0, (char**)&ps, n*sizeof(*ps)) < 0)
+    return -1;
+  return getpinfo(ps, n);
+}
@@ -3,6 +3,7 @@
 #include "user.h"
 
 #define NUM_THREAD 5
+#define NUM_CYCLE 1000
 
 int status;
 thread_t thread[NUM_THREAD];
@@ -99,6 +100,12 @@ void *thread_sbrk(void *arg)
   thread_exit(arg);
   return 0;
 }
+void *thread_nop(void *arg)
+{
+  thread_exit(arg);
+  return 0;
+}
+
 void create_all(int n, void *(*entry)(void *))
 {
   int i;
@@ -125,6 +132,29 @@ void join_all(int n)
   }
 }
 
+// Joined threads' stacks must be reused, so sz stays put.
+void create_join_bench()
+{
+  char *before;
+  int i, start, elapsed;
+
+  // the first round may grow sz, later ones must reuse its stacks
+  create_all(NUM_THREAD, thread_nop);
+  join_all(NUM_THREAD);
+  before = sbrk(0);
+  start = uptime();
+  for (i = 0; i < NUM_CYCLE; i++) {
+    create_all(NUM_THREAD, thread_nop);
+    join_all(NUM_THREAD);
+  }
+  elapsed = uptime() - start;
+  printf(1, "%d create/join pairs in %d ticks\n", NUM_CYCLE * NUM_THREAD, elapsed);
+  if (sbrk(0) != before) {
+    printf(1, "Address space grew from %p to %p\n", before, sbrk(0));
+    failed();
+  }
+}
+
 int main(int argc, char *argv[])
 {
   int i;
@@ -161,6 +191,10 @@ int main(int argc, char *argv[])
   join_all(NUM_THREAD);
   printf(1, "Test 3 passed\n\n");
 
+  printf(1, "Test 4: Create/join throughput\n");
+  create_join_bench();
+  printf(1, "Test 4 passed\n\n");
+
   printf(1, "All tests passed!\n");
   exit();
 }
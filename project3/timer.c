@@ -0,0 +1,148 @@
+// Hierarchical timer wheel for processes sleeping on a deadline.
+//
+// Level 0 has a slot per tick; a slot of each higher level spans
+// one full turn of the level below. A timer is filed at the
+// lowest level whose range covers its deadline and moves down a
+// level each time its slot comes up, so a tick only touches the
+// timers that are due or moving down.
+//
+// Everything here runs under tickslock. Lock order: tickslock,
+// then ptable.lock (taken by wakeup()).
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+
+#define WHEELBITS 6
+#define WHEELSIZE (1 << WHEELBITS)
+#define WHEELMASK (WHEELSIZE - 1)
+#define NWHEEL    4
+#define MAXDELTA  ((1u << (WHEELBITS*NWHEEL)) - 1)
+
+static struct timer *wheel[NWHEEL][WHEELSIZE];
+static uint wheelnow;  // last tick the wheel has processed
+
+// File t in the slot its deadline falls into, or in the slot of
+// tick first if that deadline is earlier: the next tick for a new
+// timer, the current one for a timer moving down, whose slot is
+// drained right after. Deadlines beyond the top level's range go
+// as far out as possible and are filed again when that slot
+// comes up.
+static void
+place(struct timer *t, uint first)
+{
+  uint delta, e;
+  int lv;
+
+  if((int)(t->expires - first) <= 0)
+    e = first;
+  else
+    e = t->expires;
+  delta = e - wheelnow;
+  if(delta > MAXDELTA){
+    delta = MAXDELTA;
+    e = wheelnow + MAXDELTA;
+  }
+  for(lv = 0; lv < NWHEEL-1 && delta >= 1u << (WHEELBITS*(lv+1)); lv++)
+    ;
+  t->slot = &wheel[lv][(e >> (WHEELBITS*lv)) & WHEELMASK];
+  t->prev = 0;
+  t->next = *t->slot;
+  if(t->next)
+    t->next->prev = t;
+  *t->slot = t;
+}
+
+// Wake t->chan at tick expires.
+void
+timeradd(struct timer *t, uint expires)
+{
+  if(!holding(&tickslock))
+    panic("timeradd");
+  if(t->slot)
+    timerdel(t);
+  t->expires = expires;
+  place(t, wheelnow + 1);
+}
+
+// Take t off the wheel if it is still pending.
+void
+timerdel(struct timer *t)
+{
+  if(!holding(&tickslock))
+    panic("timerdel");
+  if(t->slot == 0)
+    return;
+  if(t->prev)
+    t->prev->next = t->next;
+  else
+    *t->slot = t->next;
+  if(t->next)
+    t->next->prev = t->prev;
+  t->slot = 0;
+}
+
+// Detach and return the list in slot.
+static struct timer*
+takeslot(struct timer **slot)
+{
+  struct timer *t = *slot;
+
+  *slot = 0;
+  return t;
+}
+
+// Catch the wheel up with ticks, firing the timers that came due.
+// Called by the timer interrupt with tickslock held.
+void
+timertick(void)
+{
+  struct timer *t, *next;
+  int lv;
+
+  while(wheelnow != ticks){
+    wheelnow++;
+    // At the start of each turn of a level, move the next
+    // slot of the level above down.
+    for(lv = 1; lv < NWHEEL; lv++){
+      if(((wheelnow >> (WHEELBITS*(lv-1))) & WHEELMASK) != 0)
+        break;
+      t = takeslot(&wheel[lv][(wheelnow >> (WHEELBITS*lv)) & WHEELMASK]);
+      for(; t; t = next){
+        next = t->next;
+        place(t, wheelnow);
+      }
+    }
+    t = takeslot(&wheel[0][wheelnow & WHEELMASK]);
+    for(; t; t = next){
+      next = t->next;
+      t->slot = 0;
+      wakeup(t->chan);
+    }
+  }
+}
+
+// Sleep until ticks reaches deadline; 0 on time, -1 if killed.
+// Caller holds tickslock.
+int
+sleepuntil(uint deadline)
+{
+  struct proc *p = myproc();
+
+  p->timer.chan = &p->timer;
+  while((int)(ticks - deadline) < 0){
+    if(p->killed){
+      timerdel(&p->timer);
+      return -1;
+    }
+    if(p->timer.slot == 0)
+      timeradd(&p->timer, deadline);
+    sleep(&p->timer, &tickslock);
+  }
+  return 0;
+}
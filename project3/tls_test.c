@@ -0,0 +1,118 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define NUM_THREAD 8
+#define NUM_ROUND 100
+
+thread_t thread[NUM_THREAD];
+int *base[NUM_THREAD];
+uint block[TLSSIZE/4];
+
+void failed()
+{
+  printf(1, "Test failed!\n");
+  exit();
+}
+
+// A fresh block points at itself and is otherwise zero.
+int fresh(int *t)
+{
+  int i;
+
+  if (t[0] != (int)t)
+    return 0;
+  for (i = 1; i < TLSSIZE/4; i++)
+    if (t[i] != 0)
+      return 0;
+  return 1;
+}
+
+// Keep a private counter in the local block across switches.
+void *counter(void *arg)
+{
+  int *t = tls();
+  int i;
+
+  if (!fresh(t))
+  {
+    printf(1, "Thread %d: block not fresh\n", (int)arg);
+    failed();
+  }
+  base[(int)arg] = t;
+  for (i = 0; i < NUM_ROUND; i++)
+  {
+    ((int *)tls())[TLS_USER]++;
+    yield();
+  }
+  if (t[TLS_USER] != NUM_ROUND)
+  {
+    printf(1, "Thread %d: counter %d\n", (int)arg, t[TLS_USER]);
+    failed();
+  }
+  thread_exit(arg);
+  return 0;
+}
+
+void run(void)
+{
+  int i, j;
+  void *retval;
+
+  for (i = 0; i < NUM_THREAD; i++)
+    if (thread_create(&thread[i], counter, (void *)i) != 0)
+      failed();
+  for (i = 0; i < NUM_THREAD; i++)
+    thread_join(thread[i], &retval);
+  for (i = 0; i < NUM_THREAD; i++)
+    for (j = i + 1; j < NUM_THREAD; j++)
+      if (base[i] == base[j])
+      {
+        printf(1, "Threads %d and %d share a block\n", i, j);
+        failed();
+      }
+}
+
+int main(int argc, char *argv[])
+{
+  int pid;
+
+  printf(1, "Test 1: Main thread\n");
+  if (!fresh(tls()))
+    failed();
+  printf(1, "Test 1 passed\n\n");
+
+  printf(1, "Test 2: Threads\n");
+  run();
+  printf(1, "Test 2 passed\n\n");
+
+  printf(1, "Test 3: Reused stacks\n");
+  run();
+  printf(1, "Test 3 passed\n\n");
+
+  printf(1, "Test 4: settls\n");
+  block[0] = (uint)block;
+  block[TLS_USER] = 42;
+  if (settls(block) != 0 || tls() != block)
+    failed();
+  if (settls((void *)0xffffff00) == 0)
+  {
+    printf(1, "settls outside the address space succeeded\n");
+    failed();
+  }
+  if ((pid = fork()) == 0)
+  {
+    if (tls() != block || ((int *)tls())[TLS_USER] != 42)
+    {
+      printf(1, "Child lost the block\n");
+      failed();
+    }
+    exit();
+  }
+  wait();
+  printf(1, "Test 4 passed\n\n");
+
+  printf(1, "All tests passed!\n");
+  exit();
+}
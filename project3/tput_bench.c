@@ -0,0 +1,86 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NUM_CHILD 8
+#define RUN_TICKS 300
+#define UNIT 100000
+
+// CPU-bound children, half with even and half with odd pids,
+// work for RUN_TICKS and report how many units they finished.
+// Build once per SCHED_POLICY and compare the totals; the
+// smallest count shows whether any child starved.
+
+// Spin until end, counting units of work.
+int work(int end)
+{
+  volatile int i;
+  int n;
+
+  n = 0;
+  while (uptime() < end)
+  {
+    for (i = 0; i < UNIT; i++)
+      ;
+    n++;
+  }
+  return n;
+}
+
+int main(int argc, char *argv[])
+{
+  int fd[2], msg[2], count[NUM_CHILD];
+  int i, p, start, total, least;
+
+  printf(1, "throughput bench start\n");
+  if (pipe(fd) < 0)
+  {
+    printf(1, "pipe failed\n");
+    exit();
+  }
+  start = uptime() + 20;
+  for (i = 0; i < NUM_CHILD; i++)
+  {
+    if ((p = fork()) < 0)
+    {
+      printf(1, "fork failed\n");
+      exit();
+    }
+    if (p == 0)
+    {
+      close(fd[0]);
+      while (uptime() < start)
+        ;
+      msg[0] = i;
+      msg[1] = work(start + RUN_TICKS);
+      write(fd[1], msg, sizeof(msg));
+      exit();
+    }
+  }
+  close(fd[1]);
+  for (i = 0; i < NUM_CHILD; i++)
+  {
+    if (read(fd[0], msg, sizeof(msg)) != sizeof(msg))
+    {
+      printf(1, "child failed\n");
+      exit();
+    }
+    count[msg[0]] = msg[1];
+  }
+  close(fd[0]);
+  for (i = 0; i < NUM_CHILD; i++)
+    wait();
+
+  total = 0;
+  least = count[0];
+  for (i = 0; i < NUM_CHILD; i++)
+  {
+    printf(1, "child %d: %d units\n", i, count[i]);
+    total += count[i];
+    if (count[i] < least)
+      least = count[i];
+  }
+  printf(1, "%d units in %d ticks, least %d\n", total, RUN_TICKS, least);
+  printf(1, "throughput bench finished\n");
+  exit();
+}
@@ -13,6 +13,8 @@ struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
+volatile uint boostepoch;  // bumped every boostperiod; see priority_boosting
+volatile uint boostperiod = BOOSTTICKS;
 
 void
 tvinit(void)
@@ -51,9 +53,26 @@ trap(struct trapframe *tf)
     if(cpuid() == 0){
       acquire(&tickslock);
       ticks++;
-      wakeup(&ticks);
+      if(boostperiod && ticks % boostperiod == 0)
+        boostepoch++;
+      timertick();
       release(&tickslock);
     }
+    mycpu()->ticks++;
+    if(mycpu()->idle)
+      mycpu()->idleticks++;
+    //charge the tick to whoever it interrupted.
+    if(myproc() && myproc()->state == RUNNING){
+      if((tf->cs&3) == DPL_USER)
+        myproc()->utime++;
+      else
+        myproc()->stime++;
+      myproc()->lvticks[myproc()->level]++;
+    }
+    lapiceoi();
+    break;
+  case T_IRQ0 + IRQ_WAKEUP:
+    // Only has to end the hlt in the idle loop.
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -77,6 +96,17 @@ trap(struct trapframe *tf)
             cpuid(), tf->cs, tf->eip);
     lapiceoi();
     break;
+  case T_PGFLT:
+    // First touch of heap that sbrk() did not back, or a write to
+    // a page fork() left shared. Either may come from user space
+    // or from a system call using a user buffer.
+    if(myproc() && rcr2() < KERNBASE){
+      if(!(tf->err & FEC_PR) && lazyfault(myproc()->vm, rcr2()) == 0)
+        break;
+      if((tf->err & FEC_WR) && cowfault(myproc()->vm->pgdir, rcr2()) == 0)
+        break;
+    }
+    // fall through
 
   //PAGEBREAK: 13
   default:
@@ -103,8 +133,10 @@ trap(struct trapframe *tf)
   // Force process to give up CPU on clock tick.
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     tf->trapno == T_IRQ0+IRQ_TIMER){
+    myproc()->nivcsw++;
     yield();
+  }
 
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
@@ -5,6 +5,13 @@
 
 // Memory allocator by Kernighan and Ritchie,
 // The C programming Language, 2nd ed.  Section 8.7.
+//
+// Threads share it, so requests up to SMALLUNITS go to size
+// classes instead: each thread keeps a free list per class in a
+// cache found through its local block, and trades blocks with the
+// central heap BATCH at a time. Only refills, drains and large
+// blocks take heaplock. The cache hangs off word TLS_MALLOC of the
+// local block, and thread_exit() hands it back.
 
 typedef long Align;
 
@@ -18,15 +25,36 @@ union header {
 
 typedef union header Header;
 
+#define NCLASS      8     // size classes of 16, 32, ... 2048 bytes
+#define SMALLUNITS  (2 << (NCLASS-1))  // units of the largest class
+#define BATCH       32    // blocks moved between a cache and the heap
+#define MAXCACHED   (2*BATCH)  // blocks a cache keeps per class
+#define CARVEUNITS  1024  // units split into blocks when a class runs dry
+
+// Free blocks of one thread, by size class.
+struct mcache {
+  Header *list[NCLASS];
+  int count[NCLASS];
+  void *owner;            // local block of the thread using it
+  struct mcache *next;
+};
+
 static Header base;
 static Header *freep;
 
-void
-free(void *ap)
+static mutex_t heaplock;          // everything below, and the K&R list
+static Header *central[NCLASS];   // free small blocks by class
+static int ncentral[NCLASS];
+static struct mcache *caches;
+static uint heapsize;             // bytes taken with sbrk
+static uint freeunits;            // units on the K&R list
+
+static void
+bigfree(Header *bp)
 {
-  Header *bp, *p;
+  Header *p;
 
-  bp = (Header*)ap - 1;
+  freeunits += bp->s.size;
   for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
     if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
       break;
@@ -54,19 +82,18 @@ morecore(uint nu)
   p = sbrk(nu * sizeof(Header));
   if(p == (char*)-1)
     return 0;
+  heapsize += nu * sizeof(Header);
   hp = (Header*)p;
   hp->s.size = nu;
-  free((void*)(hp + 1));
+  bigfree(hp);
   return freep;
 }
 
-void*
-malloc(uint nbytes)
+static Header*
+bigalloc(uint nunits)
 {
   Header *p, *prevp;
-  uint nunits;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
   if((prevp = freep) == 0){
     base.s.ptr = freep = prevp = &base;
     base.s.size = 0;
@@ -81,10 +108,231 @@ malloc(uint nbytes)
         p->s.size = nunits;
       }
       freep = prevp;
-      return (void*)(p + 1);
+      freeunits -= nunits;
+      return p;
     }
     if(p == freep)
       if((p = morecore(nunits)) == 0)
         return 0;
   }
 }
+
+static int
+sizeclass(uint nunits)
+{
+  int cls;
+
+  for(cls = 0; (2u << cls) < nunits; cls++)
+    ;
+  return cls;
+}
+
+// Split a fresh run of CARVEUNITS into blocks of class cls on
+// the central list. Caller holds heaplock.
+static int
+carve(int cls)
+{
+  Header *p;
+  uint u = 2 << cls;
+  int i;
+
+  if((p = bigalloc(CARVEUNITS)) == 0)
+    return -1;
+  for(i = 0; i < CARVEUNITS/u; i++, p += u){
+    p->s.size = u;
+    p->s.ptr = central[cls];
+    central[cls] = p;
+    ncentral[cls]++;
+  }
+  return 0;
+}
+
+// This thread's cache. A thread that reuses the stack of one
+// that exited picks up the cache it left behind.
+static struct mcache*
+mycache(void)
+{
+  void **t = tls();
+  struct mcache *c;
+
+  if((c = t[TLS_MALLOC]) != 0)
+    return c;
+  mutex_lock(&heaplock);
+  for(c = caches; c; c = c->next)
+    if(c->owner == t)
+      break;
+  if(c == 0){
+    c = (struct mcache*)bigalloc((sizeof(*c) + sizeof(Header) - 1)/sizeof(Header) + 1);
+    if(c){
+      c = (struct mcache*)((Header*)c + 1);
+      memset(c, 0, sizeof(*c));
+      c->owner = t;
+      c->next = caches;
+      caches = c;
+    }
+  }
+  mutex_unlock(&heaplock);
+  t[TLS_MALLOC] = c;
+  return c;
+}
+
+// Give this thread's cached blocks back to the central heap and
+// free its cache. Called by thread_exit(), so threads that come
+// and go leave nothing stranded.
+void
+mallocexit(void)
+{
+  void **t = tls();
+  struct mcache *c, **pp;
+  Header *p;
+  int cls;
+
+  if((c = t[TLS_MALLOC]) == 0)
+    return;
+  t[TLS_MALLOC] = 0;
+  mutex_lock(&heaplock);
+  for(cls = 0; cls < NCLASS; cls++){
+    while((p = c->list[cls]) != 0){
+      c->list[cls] = p->s.ptr;
+      p->s.ptr = central[cls];
+      central[cls] = p;
+    }
+    ncentral[cls] += c->count[cls];
+  }
+  for(pp = &caches; *pp != c; pp = &(*pp)->next)
+    ;
+  *pp = c->next;
+  bigfree((Header*)c - 1);
+  mutex_unlock(&heaplock);
+}
+
+// Move up to BATCH blocks of class cls from the central heap
+// to c; 0 if there is no memory left.
+static int
+refill(struct mcache *c, int cls)
+{
+  Header *p;
+  int n;
+
+  mutex_lock(&heaplock);
+  if(central[cls] == 0 && carve(cls) < 0){
+    mutex_unlock(&heaplock);
+    return 0;
+  }
+  for(n = 0; n < BATCH && (p = central[cls]) != 0; n++){
+    central[cls] = p->s.ptr;
+    p->s.ptr = c->list[cls];
+    c->list[cls] = p;
+  }
+  ncentral[cls] -= n;
+  c->count[cls] += n;
+  mutex_unlock(&heaplock);
+  return n;
+}
+
+// Hand BATCH blocks of class cls back to the central heap.
+static void
+drain(struct mcache *c, int cls)
+{
+  Header *p;
+  int n;
+
+  mutex_lock(&heaplock);
+  for(n = 0; n < BATCH; n++){
+    p = c->list[cls];
+    c->list[cls] = p->s.ptr;
+    p->s.ptr = central[cls];
+    central[cls] = p;
+  }
+  ncentral[cls] += n;
+  c->count[cls] -= n;
+  mutex_unlock(&heaplock);
+}
+
+void
+free(void *ap)
+{
+  struct mcache *c;
+  Header *bp;
+  int cls;
+
+  if(ap == 0)
+    return;
+  bp = (Header*)ap - 1;
+  if(bp->s.size > SMALLUNITS){
+    mutex_lock(&heaplock);
+    bigfree(bp);
+    mutex_unlock(&heaplock);
+    return;
+  }
+  cls = sizeclass(bp->s.size);
+  if((c = mycache()) == 0){
+    mutex_lock(&heaplock);
+    bp->s.ptr = central[cls];
+    central[cls] = bp;
+    ncentral[cls]++;
+    mutex_unlock(&heaplock);
+    return;
+  }
+  bp->s.ptr = c->list[cls];
+  c->list[cls] = bp;
+  if(++c->count[cls] > MAXCACHED)
+    drain(c, cls);
+}
+
+void*
+malloc(uint nbytes)
+{
+  struct mcache *c;
+  Header *p;
+  uint nunits;
+  int cls;
+
+  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
+  if(nunits > SMALLUNITS){
+    mutex_lock(&heaplock);
+    p = bigalloc(nunits);
+    mutex_unlock(&heaplock);
+    return p ? (void*)(p + 1) : 0;
+  }
+  cls = sizeclass(nunits);
+  if((c = mycache()) == 0)
+    return 0;
+  if(c->list[cls] == 0 && refill(c, cls) == 0)
+    return 0;
+  p = c->list[cls];
+  c->list[cls] = p->s.ptr;
+  c->count[cls]--;
+  return (void*)(p + 1);
+}
+
+// Where the heap's bytes are. Counts in other threads' caches
+// may be a moment old.
+void
+mallinfo(struct mallinfo *mi)
+{
+  struct mcache *c;
+  Header *p;
+  int cls;
+
+  mutex_lock(&heaplock);
+  mi->heap = heapsize;
+  mi->free = freeunits * sizeof(Header);
+  mi->cached = 0;
+  for(cls = 0; cls < NCLASS; cls++){
+    mi->free += ncentral[cls] * (16 << cls);
+    for(c = caches; c; c = c->next)
+      mi->cached += c->count[cls] * (16 << cls);
+  }
+  mi->largest = 0;
+  if(freep){
+    p = freep;
+    do {
+      if(p->s.size * sizeof(Header) > mi->largest)
+        mi->largest = p->s.size * sizeof(Header);
+      p = p->s.ptr;
+    } while(p != freep);
+  }
+  mi->inuse = mi->heap - mi->free - mi->cached;
+  mutex_unlock(&heaplock);
+}
@@ -1,5 +1,9 @@
 struct stat;
 struct rtcdate;
+struct cpustat;
+struct mlfqconf;
+struct pstat;
+struct slabstat;
 
 // system calls
 int fork(void);
@@ -31,6 +35,23 @@ int getlev(void);
 int thread_create(thread_t*, void *(*)(void *), void*);
 void thread_exit(void *);
 int thread_join(thread_t, void **);
+int getcpustat(struct cpustat*, int);
+int getmlfq(struct mlfqconf*);
+int setmlfq(struct mlfqconf*);
+int settickets(int);
+int getpinfo(struct pstat*, int);
+int nanosleep(int, int);
+int futex_wait(volatile int*, int);
+int futex_wake(volatile int*, int);
+int settls(void*);
+int thread_join_any(void **);
+int thread_detach(thread_t);
+int setaffinity(int, uint);
+int getaffinity(int);
+int getcpu(void);
+int thread_create_many(thread_t*, int, void *(*)(void *), void**);
+int freemem(void);
+int getslabstat(struct slabstat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -44,4 +65,44 @@ uint strlen(const char*);
 void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
+struct mallinfo {
+  uint heap;     // bytes taken with sbrk
+  uint inuse;    // bytes in allocated blocks, headers included
+  uint cached;   // bytes free in thread caches
+  uint free;     // bytes free in the central heap
+  uint largest;  // largest free run in the central heap
+};
+void mallinfo(struct mallinfo*);
+void mallocexit(void);
 int atoi(const char*);
+
+// uthread.c
+typedef struct {
+  volatile int state;  // 0 free, 1 locked, 2 locked with waiters
+} mutex_t;
+typedef struct {
+  volatile int seq;    // bumped by every signal
+} cond_t;
+typedef struct {
+  mutex_t lock;
+  cond_t cv;
+  int n;               // threads to wait for
+  int count;           // threads arrived this round
+  int round;
+} barrier_t;
+void mutex_init(mutex_t*);
+void mutex_lock(mutex_t*);
+void mutex_unlock(mutex_t*);
+void cond_init(cond_t*);
+void cond_wait(cond_t*, mutex_t*);
+void cond_signal(cond_t*);
+void cond_broadcast(cond_t*);
+void barrier_init(barrier_t*, int);
+void barrier_wait(barrier_t*);
+void *tls(void);
+
+// Words of the thread-local block. Programs may use the block
+// from TLS_USER on; the words below belong to ulib.
+#define TLS_SELF    0  // the block's own address, for %gs:0
+#define TLS_MALLOC  1  // this thread's malloc cache
+#define TLS_USER    2  // first word free for the program
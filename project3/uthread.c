@@ -0,0 +1,152 @@
+// Mutexes, condition variables and barriers for threads,
+// built on futex_wait() and futex_wake(), access to the
+// thread-local block, and thread_exit().
+
+#include "types.h"
+#include "user.h"
+
+static inline int
+xchg(volatile int *addr, int newval)
+{
+  int result;
+
+  asm volatile("lock; xchgl %0, %1" :
+               "+m" (*addr), "=a" (result) :
+               "1" (newval) :
+               "cc");
+  return result;
+}
+
+// Store newval if *addr is old; returns what *addr held.
+static inline int
+cmpxchg(volatile int *addr, int old, int newval)
+{
+  int result;
+
+  asm volatile("lock; cmpxchgl %2, %1" :
+               "=a" (result), "+m" (*addr) :
+               "r" (newval), "0" (old) :
+               "cc");
+  return result;
+}
+
+static inline void
+atomic_inc(volatile int *addr)
+{
+  asm volatile("lock; incl %0" : "+m" (*addr) : : "cc");
+}
+
+void
+mutex_init(mutex_t *m)
+{
+  m->state = 0;
+}
+
+// Only a lock that has seen contention (state 2) costs a
+// system call, on either side.
+void
+mutex_lock(mutex_t *m)
+{
+  int c;
+
+  if((c = cmpxchg(&m->state, 0, 1)) == 0)
+    return;
+  if(c != 2)
+    c = xchg(&m->state, 2);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = xchg(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(mutex_t *m)
+{
+  if(xchg(&m->state, 0) == 2)
+    futex_wake(&m->state, 1);
+}
+
+void
+cond_init(cond_t *c)
+{
+  c->seq = 0;
+}
+
+// A signal between reading seq and futex_wait() changes seq,
+// so the wait returns at once instead of missing it.
+void
+cond_wait(cond_t *c, mutex_t *m)
+{
+  int seq = c->seq;
+
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  mutex_lock(m);
+}
+
+void
+cond_signal(cond_t *c)
+{
+  atomic_inc(&c->seq);
+  futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(cond_t *c)
+{
+  atomic_inc(&c->seq);
+  futex_wake(&c->seq, 0x7fffffff);
+}
+
+void
+barrier_init(barrier_t *b, int n)
+{
+  mutex_init(&b->lock);
+  cond_init(&b->cv);
+  b->n = n;
+  b->count = 0;
+  b->round = 0;
+}
+
+// Wait until n threads have arrived, then release them all.
+void
+barrier_wait(barrier_t *b)
+{
+  int round;
+
+  mutex_lock(&b->lock);
+  round = b->round;
+  if(++b->count == b->n){
+    b->count = 0;
+    b->round++;
+    cond_broadcast(&b->cv);
+  } else {
+    while(round == b->round)
+      cond_wait(&b->cv, &b->lock);
+  }
+  mutex_unlock(&b->lock);
+}
+
+// This thread's local block: TLSSIZE bytes the kernel set up at
+// the top of its stack, or whatever settls() moved it to. Word
+// TLS_SELF holds the block's address, so one load through %gs
+// finds it; see user.h for the other reserved words.
+void*
+tls(void)
+{
+  void *base;
+
+  asm volatile("movl %%gs:0, %0" : "=r" (base));
+  return base;
+}
+
+void _thread_exit(void*);
+
+// End the calling thread. Its malloc cache goes back to the
+// heap first; the system call does not return.
+void
+thread_exit(void *retval)
+{
+  mallocexit();
+  _thread_exit(retval);
+}
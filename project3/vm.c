@@ -6,9 +6,11 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "spinlock.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
+static struct spinlock pflock;  // serializes page fault handling
 
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
@@ -141,6 +143,7 @@ void
 kvmalloc(void)
 {
   kpgdir = setupkvm();
+  initlock(&pflock, "pgfault");
   switchkvm();
 }
 
@@ -160,7 +163,7 @@ switchuvm(struct proc *p)
     panic("switchuvm: no process");
   if(p->kstack == 0)
     panic("switchuvm: no kstack");
-  if(p->pgdir == 0)
+  if(p->vm == 0 || p->vm->pgdir == 0)
     panic("switchuvm: no pgdir");
 
   pushcli();
@@ -173,7 +176,9 @@ switchuvm(struct proc *p)
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
-  lcr3(V2P(p->pgdir));  // switch to process's address space
+  // %gs is reloaded from the trap frame on the way back to user.
+  mycpu()->gdt[SEG_UTLS] = SEG(STA_W, p->tls, 0xffffffff, DPL_USER);
+  lcr3(V2P(p->vm->pgdir));  // switch to process's address space
   popcli();
 }
 
@@ -311,9 +316,13 @@ clearpteu(pde_t *pgdir, char *uva)
 }
 
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child. With cow set the pages are shared
+// read-only instead and copied by cowfault() on the first
+// write; pgdir must be the current page table then, and no
+// other CPU may be using it. Heap and program pages never
+// touched stay unmapped in the child too.
 pde_t*
-copyuvm(pde_t *pgdir, uint sz)
+copyuvm(pde_t *pgdir, uint sz, int cow)
 {
   pde_t *d;
   pte_t *pte;
@@ -323,11 +332,18 @@ copyuvm(pde_t *pgdir, uint sz)
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0 || !(*pte & PTE_P))
+      continue;
     pa = PTE_ADDR(*pte);
+    if(cow){
+      if(*pte & PTE_W)
+        *pte = (*pte & ~PTE_W) | PTE_COW;
+      flags = PTE_FLAGS(*pte);
+      if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
+        goto bad;
+      kdup(P2V(pa));
+      continue;
+    }
     flags = PTE_FLAGS(*pte);
     if((mem = kalloc()) == 0)
       goto bad;
@@ -337,13 +353,171 @@ copyuvm(pde_t *pgdir, uint sz)
       goto bad;
     }
   }
+  if(cow)
+    lcr3(V2P(pgdir));  // drop the parent's writable TLB entries
   return d;
 
 bad:
+  if(cow)
+    lcr3(V2P(pgdir));
   freevm(d);
   return 0;
 }
 
+// Make the page at va writable again after a copy-on-write
+// fork: copy it, or take it over if nobody else maps it now.
+// Returns 0 if the page is writable afterwards, -1 if va is not
+// a user page or memory ran out.
+int
+cowfault(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  char *mem, *old;
+
+  if(va >= KERNBASE)
+    return -1;
+  acquire(&pflock);
+  pte = walkpgdir(pgdir, (char*)PGROUNDDOWN(va), 0);
+  if(pte == 0 || (*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U) ||
+     (!(*pte & PTE_W) && !(*pte & PTE_COW))){
+    release(&pflock);
+    return -1;
+  }
+  if(*pte & PTE_COW){
+    old = P2V(PTE_ADDR(*pte));
+    if(krefcnt(old) > 1){
+      if((mem = kalloc()) == 0){
+        release(&pflock);
+        return -1;
+      }
+      memmove(mem, old, PGSIZE);
+      *pte = V2P(mem) | PTE_FLAGS(*pte);
+      kfree(old);
+    }
+    *pte = (*pte | PTE_W) & ~PTE_COW;
+  }
+  release(&pflock);
+  // Another CPU may have fixed it already while this one still
+  // had the read-only entry cached.
+  if(rcr3() == V2P(pgdir))
+    lcr3(V2P(pgdir));
+  return 0;
+}
+
+// Map the page at va, which exec() or sbrk() added to vm without
+// backing it. Pages of a program segment are read from the
+// executable, which sleeps, so the caller must hold no spinlock
+// then; heap and bss pages are just zeroed. Returns 0 if the page
+// is there afterwards, -1 if va is outside the process, the read
+// failed or memory ran out.
+int
+lazyfault(struct vmspace *vm, uint va)
+{
+  pte_t *pte;
+  struct vmseg *s;
+  char *mem;
+  uint n;
+  int loaded;
+
+  va = PGROUNDDOWN(va);
+  if(va >= vm->sz || va >= KERNBASE)
+    return -1;
+  if((pte = walkpgdir(vm->pgdir, (char*)va, 0)) != 0 && (*pte & PTE_P))
+    return 0;
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  loaded = 0;
+  for(s = vm->seg; s < &vm->seg[vm->nseg]; s++){
+    if(va < s->va || va - s->va >= s->memsz)
+      continue;
+    if(va - s->va < s->filesz){
+      n = s->filesz - (va - s->va);
+      if(n > PGSIZE)
+        n = PGSIZE;
+      ilock(vm->ip);
+      if(readi(vm->ip, mem, s->off + (va - s->va), n) != n){
+        iunlock(vm->ip);
+        kfree(mem);
+        return -1;
+      }
+      iunlock(vm->ip);
+      loaded = 1;
+    }
+    break;
+  }
+  acquire(&pflock);
+  // Another thread sharing vm may have faulted it in first.
+  if((pte = walkpgdir(vm->pgdir, (char*)va, 0)) != 0 && (*pte & PTE_P)){
+    release(&pflock);
+    kfree(mem);
+    return 0;
+  }
+  if(mappages(vm->pgdir, (char*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    release(&pflock);
+    kfree(mem);
+    return -1;
+  }
+  // Counted under pflock, as sibling threads fault concurrently.
+  vm->nfault++;
+  vm->nload += loaded;
+  release(&pflock);
+  return 0;
+}
+
+// Fault in every page of [va, va+n) that is not mapped yet, so
+// system calls can then use a user buffer while holding locks.
+int
+uvmtouch(struct vmspace *vm, uint va, uint n)
+{
+  uint a;
+
+  if(n == 0)
+    return 0;
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE)
+    if(lazyfault(vm, a) < 0)
+      return -1;
+  return 0;
+}
+
+// Number of pages below sz that are mapped.
+uint
+uvmresident(pde_t *pgdir, uint sz)
+{
+  pde_t *pde;
+  pte_t *pgtab;
+  uint va, n;
+
+  n = 0;
+  for(va = 0; va < sz; va += PGSIZE){
+    pde = &pgdir[PDX(va)];
+    if(!(*pde & PTE_P)){
+      va = PGADDR(PDX(va) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
+    if(pgtab[PTX(va)] & PTE_P)
+      n++;
+  }
+  return n;
+}
+
+// Give the process its own copy of every page it still shares
+// after fork. Returns -1 if memory ran out.
+int
+cowbreak(pde_t *pgdir, uint sz)
+{
+  pte_t *pte;
+  uint va;
+
+  for(va = 0; va < sz; va += PGSIZE){
+    pte = walkpgdir(pgdir, (char*)va, 0);
+    if(pte && (*pte & PTE_COW) && cowfault(pgdir, va) < 0)
+      return -1;
+  }
+  return 0;
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
@@ -352,7 +526,7 @@ uva2ka(pde_t *pgdir, char *uva)
   pte_t *pte;
 
   pte = walkpgdir(pgdir, uva, 0);
-  if((*pte & PTE_P) == 0)
+  if(pte == 0 || (*pte & PTE_P) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
@@ -361,16 +535,24 @@ uva2ka(pde_t *pgdir, char *uva)
 
 // Copy len bytes from p to user address va in page table pgdir.
 // Most useful when pgdir is not the current page table.
-// uva2ka ensures this only works for PTE_U pages.
+// uva2ka ensures this only works for PTE_U pages. Untouched heap
+// is faulted in only when pgdir belongs to the current process.
 int
 copyout(pde_t *pgdir, uint va, void *p, uint len)
 {
+  pte_t *pte;
   char *buf, *pa0;
   uint n, va0;
 
   buf = (char*)p;
   while(len > 0){
     va0 = (uint)PGROUNDDOWN(va);
+    pte = walkpgdir(pgdir, (char*)va0, 0);
+    if((pte == 0 || !(*pte & PTE_P)) && myproc() &&
+       myproc()->vm->pgdir == pgdir && lazyfault(myproc()->vm, va0) < 0)
+      return -1;
+    if(pte && (*pte & PTE_COW) && cowfault(pgdir, va0) < 0)
+      return -1;
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0)
       return -1;
@@ -385,6 +567,18 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
   return 0;
 }
 
+// Set up an empty thread-local block at va in pgdir. The first
+// word points at the block itself, so %gs:0 gives its address.
+int
+tlsinit(pde_t *pgdir, uint va)
+{
+  uint tls[TLSSIZE/4];
+
+  memset(tls, 0, sizeof(tls));
+  tls[0] = va;
+  return copyout(pgdir, va, tls, sizeof(tls));
+}
+
 //PAGEBREAK!
 // Blank page.
 //PAGEBREAK!